@@ -1,5 +1,29 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 /**
  * Abstract Factory Design Pattern
@@ -11,25 +35,275 @@
  * and is related to the corresponding calendar entry.
  */
 
+/**
+ * Title table interns the titles of calendar entries. Entries and reminders only store the id of
+ * their title, and equal titles are stored once.
+ */
+class TitleTable
+{
+public:
+  static TitleTable &Instance()
+  {
+    static TitleTable title_table;
+    return title_table;
+  }
+
+  std::uint32_t Intern(const std::string &title)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unordered_map<std::string, std::uint32_t>::const_iterator id = ids_.find(title);
+    if (id != ids_.end())
+    {
+      return id->second;
+    }
+    titles_.push_back(title);
+    ids_[title] = static_cast<std::uint32_t>(titles_.size() - 1);
+    return static_cast<std::uint32_t>(titles_.size() - 1);
+  }
+
+  std::string Title(std::uint32_t id)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return titles_.at(id);
+  }
+
+private:
+  TitleTable() {}
+  std::mutex mutex_;
+  std::vector<std::string> titles_;
+  std::unordered_map<std::string, std::uint32_t> ids_;
+};
+
+/**
+ * Calendar time conversions. Points in time are stored as minutes since 01.01.1970 (epoch minutes),
+ * which is parsed once from the text given by the client ("03.05.2024", "10:30 a.m.", "1 hour").
+ */
+namespace calendar_time
+{
+// days since 01.01.1970 of a civil date (proleptic Gregorian calendar)
+inline std::int32_t DaysFromCivil(int year, int month, int day)
+{
+  year -= month <= 2;
+  const int era = (year >= 0 ? year : year - 399) / 400;
+  const int year_of_era = year - era * 400;
+  const int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+inline void CivilFromDays(std::int32_t days, int &year, int &month, int &day)
+{
+  days += 719468;
+  const int era = (days >= 0 ? days : days - 146096) / 146097;
+  const int day_of_era = days - era * 146097;
+  const int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  const int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  const int month_index = (5 * day_of_year + 2) / 153;
+  day = day_of_year - (153 * month_index + 2) / 5 + 1;
+  month = month_index + (month_index < 10 ? 3 : -9);
+  year = year_of_era + era * 400 + (month <= 2);
+}
+
+// range of the parsed dates and durations, chosen so that start and end minute of an entry fit
+// into the 32-bit epoch minutes
+constexpr int kMinYear = 1900;
+constexpr int kMaxYear = 2999;
+constexpr std::int32_t kMaxDurationMinutes = 366 * 1440;
+
+inline int DaysInMonth(int year, int month)
+{
+  static constexpr int kDaysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  const bool leap_year = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+  return month == 2 && leap_year ? 29 : kDaysInMonth[month - 1];
+}
+
+// reads the unsigned decimal number at text[position], and moves position behind it
+inline bool ReadNumber(std::string_view text, std::size_t &position, int &value)
+{
+  if (position >= text.size() || text[position] < '0' || text[position] > '9')
+  {
+    return false;
+  }
+  const char *end = text.data() + text.size();
+  std::from_chars_result result = std::from_chars(text.data() + position, end, value);
+  if (result.ec != std::errc())
+  {
+    return false;
+  }
+  position = result.ptr - text.data();
+  return true;
+}
+
+inline bool ReadCharacter(std::string_view text, std::size_t &position, char character)
+{
+  if (position >= text.size() || text[position] != character)
+  {
+    return false;
+  }
+  position++;
+  return true;
+}
+
+// "dd.mm.yyyy", a day which does not exist in its month and years outside [kMinYear, kMaxYear] are rejected
+inline std::int32_t ParseDate(const std::string &date)
+{
+  int day = 0, month = 0, year = 0;
+  std::size_t position = 0;
+  if (!ReadNumber(date, position, day) || !ReadCharacter(date, position, '.') || !ReadNumber(date, position, month) ||
+      !ReadCharacter(date, position, '.') || !ReadNumber(date, position, year) || position != date.size() ||
+      year < kMinYear || year > kMaxYear || month < 1 || month > 12 || day < 1 || day > DaysInMonth(year, month))
+  {
+    throw std::invalid_argument("Invalid date: " + date);
+  }
+  return DaysFromCivil(year, month, day);
+}
+
+// "10:30 a.m.", "2:00 p.m." or "14:00" (minutes always with two digits), returns minutes since midnight
+inline std::int32_t ParseTime(const std::string &time)
+{
+  int hour = 0, minute = 0;
+  std::size_t position = 0;
+  if (!ReadNumber(time, position, hour) || !ReadCharacter(time, position, ':') || !ReadNumber(time, position, minute) ||
+      time[position - 3] != ':' || hour > 23 || minute > 59)
+  {
+    throw std::invalid_argument("Invalid time: " + time);
+  }
+  std::string_view suffix = std::string_view(time).substr(position);
+  if (suffix == " a.m." || suffix == " p.m.")
+  {
+    if (hour < 1 || hour > 12)
+    {
+      throw std::invalid_argument("Invalid time: " + time);
+    }
+    hour = hour % 12 + (suffix == " p.m." ? 12 : 0);
+  }
+  else if (!suffix.empty())
+  {
+    throw std::invalid_argument("Invalid time: " + time);
+  }
+  return hour * 60 + minute;
+}
+
+// "1 hour", "2 hours", "45 minutes" or "1 hour 30 minutes", at most kMaxDurationMinutes in total
+inline std::int32_t ParseDuration(const std::string &duration)
+{
+  std::int32_t minutes = 0;
+  std::size_t position = 0;
+  bool any = false;
+  while (position < duration.size())
+  {
+    int value = 0;
+    if ((any && !ReadCharacter(duration, position, ' ')) || !ReadNumber(duration, position, value) ||
+        !ReadCharacter(duration, position, ' '))
+    {
+      throw std::invalid_argument("Invalid duration: " + duration);
+    }
+    std::size_t unit_end = std::min(duration.find(' ', position), duration.size());
+    std::string_view unit = std::string_view(duration).substr(position, unit_end - position);
+    std::int32_t unit_minutes = 0;
+    if (unit == "hour" || unit == "hours")
+    {
+      unit_minutes = 60;
+    }
+    else if (unit == "minute" || unit == "minutes")
+    {
+      unit_minutes = 1;
+    }
+    if (unit_minutes == 0 || value > (kMaxDurationMinutes - minutes) / unit_minutes)
+    {
+      throw std::invalid_argument("Invalid duration: " + duration);
+    }
+    minutes += value * unit_minutes;
+    position = unit_end;
+    any = true;
+  }
+  if (!any)
+  {
+    throw std::invalid_argument("Invalid duration: " + duration);
+  }
+  return minutes;
+}
+
+inline std::string FormatDate(std::int32_t epoch_minute)
+{
+  std::int32_t days = epoch_minute >= 0 ? epoch_minute / 1440 : -((-epoch_minute + 1439) / 1440);
+  int year = 0, month = 0, day = 0;
+  CivilFromDays(days, year, month, day);
+  char text[32];
+  std::snprintf(text, sizeof(text), "%02d.%02d.%04d", day, month, year);
+  return text;
+}
+
+inline std::string FormatTime(std::int32_t epoch_minute)
+{
+  std::int32_t minute_of_day = ((epoch_minute % 1440) + 1440) % 1440;
+  int hour = minute_of_day / 60;
+  char text[16];
+  std::snprintf(text, sizeof(text), "%d:%02d %s", hour % 12 == 0 ? 12 : hour % 12, minute_of_day % 60, hour < 12 ? "a.m." : "p.m.");
+  return text;
+}
+
+inline std::string FormatDuration(std::int32_t minutes)
+{
+  std::string text;
+  if (minutes >= 60)
+  {
+    text = std::to_string(minutes / 60) + (minutes / 60 == 1 ? " hour" : " hours");
+  }
+  if (minutes % 60 != 0 || minutes == 0)
+  {
+    text += (text.empty() ? "" : " ") + std::to_string(minutes % 60) + (minutes % 60 == 1 ? " minute" : " minutes");
+  }
+  return text;
+}
+} // namespace calendar_time
+
+/**
+ * Compact representation of a calendar entry: start in epoch minutes, duration in minutes and the
+ * id of the interned title. Comparisons and range checks are integer math.
+ */
+struct CalendarEntryRecord
+{
+  std::int32_t start_minute;
+  std::int32_t duration_minutes;
+  std::uint32_t title_id;
+
+  std::int32_t EndMinute() const { return start_minute + duration_minutes; }
+  bool Overlaps(std::int32_t begin_minute, std::int32_t end_minute) const
+  {
+    return start_minute < end_minute && begin_minute < this->EndMinute();
+  }
+  bool operator<(const CalendarEntryRecord &other) const { return start_minute < other.start_minute; }
+};
+
+static_assert(sizeof(CalendarEntryRecord) == 12, "calendar entry record should stay compact");
+
 /**
  * Abstract calendar entry (Abstract product A)
  */
 class CalendarEntry
 {
 public:
-  std::string date;
-  std::string time_start;
-  std::string duration;
-  std::string title;
+  CalendarEntryRecord record;
   virtual ~CalendarEntry(){};
   virtual void ShowCalendarEntryInfo() const = 0;
   CalendarEntry(std::string title, std::string date, std::string time_start, std::string duration)
+      : record(ParseRecord(title, date, time_start, duration)) {}
+  CalendarEntry(const CalendarEntryRecord &record) : record(record) {}
+
+  static CalendarEntryRecord ParseRecord(const std::string &title, const std::string &date, const std::string &time_start, const std::string &duration)
   {
-    this->title = title;
-    this->date = date;
-    this->time_start = time_start;
-    this->duration = duration;
+    CalendarEntryRecord parsed;
+    parsed.start_minute = calendar_time::ParseDate(date) * 1440 + calendar_time::ParseTime(time_start);
+    parsed.duration_minutes = calendar_time::ParseDuration(duration);
+    parsed.title_id = TitleTable::Instance().Intern(title);
+    return parsed;
   }
+
+  std::string Title() const { return TitleTable::Instance().Title(record.title_id); }
+  std::string Date() const { return calendar_time::FormatDate(record.start_minute); }
+  std::string TimeStart() const { return calendar_time::FormatTime(record.start_minute); }
+  std::string Duration() const { return calendar_time::FormatDuration(record.duration_minutes); }
 };
 
 /**
@@ -41,7 +315,7 @@ public:
   using CalendarEntry::CalendarEntry;
   void ShowCalendarEntryInfo() const override
   {
-    std::cout << "Google calendar entry: " + this->title + " on " + this->date + " starting at " + this->time_start + " for " + this->duration << "\n";
+    std::cout << "Google calendar entry: " + this->Title() + " on " + this->Date() + " starting at " + this->TimeStart() + " for " + this->Duration() << "\n";
   }
 };
 
@@ -54,7 +328,7 @@ public:
   using CalendarEntry::CalendarEntry;
   void ShowCalendarEntryInfo() const override
   {
-    std::cout << "Outlook calendar entry: " + this->title + " on " + this->date + " starting at " + this->time_start + " for " + this->duration << "\n";
+    std::cout << "Outlook calendar entry: " + this->Title() + " on " + this->Date() + " starting at " + this->TimeStart() + " for " + this->Duration() << "\n";
   }
 };
 
@@ -67,7 +341,7 @@ public:
   using CalendarEntry::CalendarEntry;
   void ShowCalendarEntryInfo() const override
   {
-    std::cout << "Local calendar entry: " + this->title + " on " + this->date + " starting at " + this->time_start + " for " + this->duration << "\n";
+    std::cout << "Local calendar entry: " + this->Title() + " on " + this->Date() + " starting at " + this->TimeStart() + " for " + this->Duration() << "\n";
   }
 };
 
@@ -77,15 +351,18 @@ public:
 class ReminderItem
 {
 public:
-  std::string title;
-  std::string date;
+  std::uint32_t title_id;
+  std::int32_t start_minute;
   virtual ~ReminderItem(){};
   virtual void ShowReminderItemInfo() const = 0;
   ReminderItem(const CalendarEntry &calender_entry)
   {
-    this->title = calender_entry.title;
-    this->date = calender_entry.date;
+    this->title_id = calender_entry.record.title_id;
+    this->start_minute = calender_entry.record.start_minute;
   }
+
+  std::string Title() const { return TitleTable::Instance().Title(title_id); }
+  std::string Date() const { return calendar_time::FormatDate(start_minute); }
 };
 
 /**
@@ -97,7 +374,7 @@ public:
   using ReminderItem::ReminderItem;
   void ShowReminderItemInfo() const override
   {
-    std::cout << "Google reminder: " + this->title + " on " + this->date << "\n";
+    std::cout << "Google reminder: " + this->Title() + " on " + this->Date() << "\n";
   }
 };
 
@@ -110,7 +387,7 @@ public:
   using ReminderItem::ReminderItem;
   void ShowReminderItemInfo() const override
   {
-    std::cout << "Outlook reminder: " + this->title + " on " + this->date << "\n";
+    std::cout << "Outlook reminder: " + this->Title() + " on " + this->Date() << "\n";
   }
 };
 
@@ -123,18 +400,406 @@ public:
   using ReminderItem::ReminderItem;
   void ShowReminderItemInfo() const override
   {
-    std::cout << "Local reminder: " + this->title + " on " + this->date << "\n";
+    std::cout << "Local reminder: " + this->Title() + " on " + this->Date() << "\n";
   }
 };
 
+/**
+ * Calendar store keeps the entry records of one calendar system in an implicit interval tree: the
+ * records are sorted by start, and the sorted array is read as a balanced binary tree in which
+ * every node also holds the latest end minute of its subtree. The tree answers overlap, conflict
+ * and free slot queries in O(log n + k), and the next entries after a point in time in O(log n + N).
+ *
+ * New records are collected in a pending buffer next to the tree. A query scans the buffer
+ * linearly as long as it holds at most max(kMinMergeRecords, sqrt(n)) records, and merges it into
+ * the tree only past that. Every query therefore costs O(log n + sqrt(n) + k) (O(log n + sqrt(n) + N)
+ * for the next entries), and bulk inserts stay cheap: interleaved Add and query calls cost
+ * O(sqrt(n)) amortized instead of a merge of the whole tree per Add. The store is not thread-safe,
+ * not even for concurrent queries.
+ */
+class CalendarStore
+{
+public:
+  void Add(const CalendarEntryRecord &record)
+  {
+    pending_.push_back(record);
+  }
+
+  void Add(const std::vector<CalendarEntryRecord> &records)
+  {
+    pending_.insert(pending_.end(), records.begin(), records.end());
+  }
+
+  std::size_t size() const
+  {
+    return nodes_.size() + pending_.size();
+  }
+
+  // entries overlapping [begin_minute, end_minute), sorted by start
+  std::vector<CalendarEntryRecord> FindOverlapping(std::int32_t begin_minute, std::int32_t end_minute) const
+  {
+    this->BuildIfPendingLarge();
+    std::vector<std::size_t> indices;
+    this->CollectOverlapping(begin_minute, end_minute, indices);
+    std::sort(indices.begin(), indices.end());
+    std::vector<CalendarEntryRecord> records;
+    records.reserve(indices.size());
+    for (std::size_t index : indices)
+    {
+      records.push_back(nodes_[index].record);
+    }
+    const std::size_t tree_record_count = records.size();
+    for (const CalendarEntryRecord &record : pending_)
+    {
+      if (record.Overlaps(begin_minute, end_minute))
+      {
+        records.push_back(record);
+      }
+    }
+    if (records.size() > tree_record_count)
+    {
+      std::sort(records.begin() + tree_record_count, records.end());
+      std::inplace_merge(records.begin(), records.begin() + tree_record_count, records.end());
+    }
+    return records;
+  }
+
+  std::vector<CalendarEntryRecord> FindConflicts(const CalendarEntryRecord &record) const
+  {
+    return this->FindOverlapping(record.start_minute, record.EndMinute());
+  }
+
+  // free time slots of at least min_duration minutes within [begin_minute, end_minute)
+  std::vector<std::pair<std::int32_t, std::int32_t>> FindFreeSlots(std::int32_t begin_minute, std::int32_t end_minute, std::int32_t min_duration) const
+  {
+    std::vector<std::pair<std::int32_t, std::int32_t>> free_slots;
+    std::int32_t free_from = begin_minute;
+    for (const CalendarEntryRecord &record : this->FindOverlapping(begin_minute, end_minute))
+    {
+      if (record.start_minute - free_from >= min_duration)
+      {
+        free_slots.emplace_back(free_from, record.start_minute);
+      }
+      free_from = std::max(free_from, record.EndMinute());
+    }
+    if (end_minute - free_from >= min_duration)
+    {
+      free_slots.emplace_back(free_from, end_minute);
+    }
+    return free_slots;
+  }
+
+  // visits all entries in the order of their start
+  template <typename Visitor>
+  void ForEach(Visitor visit) const
+  {
+    this->Build();
+    for (const Node &node : nodes_)
+    {
+      visit(node.record);
+    }
+  }
+
+  // the next count entries starting at or after from_minute
+  std::vector<CalendarEntryRecord> NextEntries(std::int32_t from_minute, std::size_t count) const
+  {
+    this->BuildIfPendingLarge();
+    std::vector<Node>::const_iterator first = std::lower_bound(nodes_.begin(), nodes_.end(), from_minute, [](const Node &node, std::int32_t minute)
+                                                               { return node.record.start_minute < minute; });
+    std::vector<CalendarEntryRecord> later_pending;
+    for (const CalendarEntryRecord &record : pending_)
+    {
+      if (record.start_minute >= from_minute)
+      {
+        later_pending.push_back(record);
+      }
+    }
+    std::sort(later_pending.begin(), later_pending.end());
+    std::vector<CalendarEntryRecord> records;
+    std::vector<CalendarEntryRecord>::const_iterator next_pending = later_pending.begin();
+    while (records.size() < count && (first != nodes_.end() || next_pending != later_pending.end()))
+    {
+      if (next_pending == later_pending.end() || (first != nodes_.end() && !(*next_pending < first->record)))
+      {
+        records.push_back((first++)->record);
+      }
+      else
+      {
+        records.push_back(*next_pending++);
+      }
+    }
+    return records;
+  }
+
+private:
+  struct Node
+  {
+    CalendarEntryRecord record;
+    std::int32_t max_end_minute;
+  };
+
+  static constexpr std::size_t kMinMergeRecords = 64;
+
+  mutable std::vector<Node> nodes_;
+  mutable std::vector<CalendarEntryRecord> pending_;
+  mutable int max_level_ = 0;
+
+  // a pending buffer longer than sqrt(n) costs more to scan per query than its merge amortized over
+  // the Add calls that filled it
+  void BuildIfPendingLarge() const
+  {
+    if (pending_.size() > kMinMergeRecords && pending_.size() * pending_.size() > nodes_.size())
+    {
+      this->Build();
+    }
+  }
+
+  // merges the pending records, and computes the latest end of every subtree level by level
+  void Build() const
+  {
+    if (pending_.empty())
+    {
+      return;
+    }
+    std::sort(pending_.begin(), pending_.end());
+    std::vector<Node> merged;
+    merged.reserve(nodes_.size() + pending_.size());
+    std::size_t pending_index = 0;
+    for (const Node &node : nodes_)
+    {
+      while (pending_index < pending_.size() && pending_[pending_index] < node.record)
+      {
+        merged.push_back({pending_[pending_index++], 0});
+      }
+      merged.push_back({node.record, 0});
+    }
+    for (; pending_index < pending_.size(); pending_index++)
+    {
+      merged.push_back({pending_[pending_index], 0});
+    }
+    nodes_.swap(merged);
+    pending_.clear();
+
+    const std::int64_t n = static_cast<std::int64_t>(nodes_.size());
+    std::int64_t last_index = 0;
+    std::int32_t last_end = 0;
+    for (std::int64_t i = 0; i < n; i += 2)
+    {
+      last_index = i;
+      last_end = nodes_[i].max_end_minute = nodes_[i].record.EndMinute();
+    }
+    int level = 1;
+    for (; (std::int64_t(1) << level) <= n; level++)
+    {
+      const std::int64_t half = std::int64_t(1) << (level - 1);
+      for (std::int64_t i = (half << 1) - 1; i < n; i += half << 2)
+      {
+        std::int32_t left_end = nodes_[i - half].max_end_minute;
+        std::int32_t right_end = i + half < n ? nodes_[i + half].max_end_minute : last_end;
+        nodes_[i].max_end_minute = std::max({nodes_[i].record.EndMinute(), left_end, right_end});
+      }
+      last_index = (last_index >> level & 1) ? last_index - half : last_index + half;
+      if (last_index < n)
+      {
+        last_end = std::max(last_end, nodes_[last_index].max_end_minute);
+      }
+    }
+    max_level_ = level - 1;
+  }
+
+  void CollectOverlapping(std::int32_t begin_minute, std::int32_t end_minute, std::vector<std::size_t> &indices) const
+  {
+    struct Frame
+    {
+      std::int64_t index;
+      int level;
+      bool left_done;
+    };
+    const std::int64_t n = static_cast<std::int64_t>(nodes_.size());
+    if (n == 0)
+    {
+      return;
+    }
+    Frame stack[64];
+    int top = 0;
+    stack[top++] = {(std::int64_t(1) << max_level_) - 1, max_level_, false};
+    while (top > 0)
+    {
+      Frame frame = stack[--top];
+      if (frame.level <= 3)
+      {
+        // small subtree, scan it linearly
+        std::int64_t first = frame.index >> frame.level << frame.level;
+        std::int64_t last = std::min(first + (std::int64_t(1) << (frame.level + 1)) - 1, n);
+        for (std::int64_t i = first; i < last && nodes_[i].record.start_minute < end_minute; i++)
+        {
+          if (begin_minute < nodes_[i].record.EndMinute())
+          {
+            indices.push_back(static_cast<std::size_t>(i));
+          }
+        }
+      }
+      else if (!frame.left_done)
+      {
+        std::int64_t left = frame.index - (std::int64_t(1) << (frame.level - 1));
+        stack[top++] = {frame.index, frame.level, true};
+        if (left >= n || nodes_[left].max_end_minute > begin_minute)
+        {
+          stack[top++] = {left, frame.level - 1, false};
+        }
+      }
+      else if (frame.index < n && nodes_[frame.index].record.start_minute < end_minute)
+      {
+        if (begin_minute < nodes_[frame.index].record.EndMinute())
+        {
+          indices.push_back(static_cast<std::size_t>(frame.index));
+        }
+        stack[top++] = {frame.index + (std::int64_t(1) << (frame.level - 1)), frame.level - 1, false};
+      }
+    }
+  }
+};
+
+/**
+ * Calendar event: a calendar entry together with its reminder item, created in one allocation.
+ */
+class CalendarEvent
+{
+public:
+  virtual ~CalendarEvent() {}
+  virtual const CalendarEntry &Entry() const = 0;
+  virtual const ReminderItem &Reminder() const = 0;
+};
+
+template <typename ConcreteEntry, typename ConcreteReminder>
+class ConcreteCalendarEvent : public CalendarEvent
+{
+public:
+  ConcreteCalendarEvent(const CalendarEntryRecord &record) : entry_(record), reminder_(entry_) {}
+  const CalendarEntry &Entry() const override { return entry_; }
+  const ReminderItem &Reminder() const override { return reminder_; }
+
+private:
+  ConcreteEntry entry_;
+  ConcreteReminder reminder_;  // constructed after entry_, which it is made from
+};
+
+/**
+ * Arena of one calendar system. Memory is bumped from blocks of 64 KiB, and the slots of destroyed
+ * events are kept in a free list for the next event; all events of a calendar system have the same
+ * size. Blocks are freed with the arena. The arena is not thread-safe.
+ */
+class CalendarArena
+{
+public:
+  CalendarArena() {}
+  CalendarArena(const CalendarArena &other) = delete;
+  void operator=(const CalendarArena &) = delete;
+
+  void *Allocate(std::size_t size, std::size_t alignment)
+  {
+    if (free_slot_ != nullptr && size == slot_size_)
+    {
+      void *slot = free_slot_;
+      free_slot_ = *static_cast<void **>(slot);
+      return slot;
+    }
+    std::size_t offset = (used_ + alignment - 1) & ~(alignment - 1);
+    if (blocks_.empty() || offset + size > kBlockSize)
+    {
+      blocks_.emplace_back(new unsigned char[std::max(kBlockSize, size + alignment)]);
+      offset = (reinterpret_cast<std::uintptr_t>(blocks_.back().get()) % alignment) == 0 ? 0 : alignment - reinterpret_cast<std::uintptr_t>(blocks_.back().get()) % alignment;
+    }
+    used_ = offset + size;
+    return blocks_.back().get() + offset;
+  }
+
+  void Deallocate(void *slot, std::size_t size)
+  {
+    if (size < sizeof(void *) || (slot_size_ != 0 && size != slot_size_))
+    {
+      return;
+    }
+    slot_size_ = size;
+    *static_cast<void **>(slot) = free_slot_;
+    free_slot_ = slot;
+  }
+
+private:
+  static constexpr std::size_t kBlockSize = 64 * 1024;
+  std::vector<std::unique_ptr<unsigned char[]>> blocks_;
+  std::size_t used_ = 0;  // bytes used in the last block
+  void *free_slot_ = nullptr;
+  std::size_t slot_size_ = 0;
+};
+
+/**
+ * Owner of a calendar event: destroys the event and returns its memory to the arena it came from.
+ * Events must not outlive their calendar system.
+ */
+class CalendarEventDeleter
+{
+public:
+  CalendarEventDeleter() {}
+  CalendarEventDeleter(CalendarArena *calendar_arena, std::size_t size) : calendar_arena_(calendar_arena), size_(size) {}
+  void operator()(CalendarEvent *calendar_event) const
+  {
+    calendar_event->~CalendarEvent();
+    calendar_arena_->Deallocate(calendar_event, size_);
+  }
+
+private:
+  CalendarArena *calendar_arena_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+typedef std::unique_ptr<CalendarEvent, CalendarEventDeleter> CalendarEventPtr;
+
 /**
  * Abstract calendar system (Abstract factory)
  */
 class CalendarSystem
 {
 public:
+  virtual ~CalendarSystem() {}
   virtual CalendarEntry *CreateCalendarEntry(std::string title, std::string date, std::string time_start, std::string duration) const = 0;
   virtual ReminderItem *CreateReminderItem(const CalendarEntry &calender_entry) const = 0;
+
+  // creates an entry and its reminder together, in one allocation from the arena of this calendar
+  // system. The text is parsed on every call, which is most of the cost of this overload; to create
+  // many events from the same text, parse it once with CalendarEntry::ParseRecord and pass the record.
+  CalendarEventPtr CreateCalendarEvent(const std::string &title, const std::string &date, const std::string &time_start, const std::string &duration)
+  {
+    return this->CreateCalendarEvent(CalendarEntry::ParseRecord(title, date, time_start, duration));
+  }
+
+  CalendarEventPtr CreateCalendarEvent(const CalendarEntryRecord &record)
+  {
+    std::size_t size = this->CalendarEventSize();
+    void *storage = calendar_arena_.Allocate(size, this->CalendarEventAlignment());
+    try
+    {
+      return CalendarEventPtr(this->CreateCalendarEventInto(storage, record), CalendarEventDeleter(&calendar_arena_, size));
+    }
+    catch (...)
+    {
+      calendar_arena_.Deallocate(storage, size);
+      throw;
+    }
+  }
+
+  // entries kept by this calendar system for range and conflict queries
+  CalendarStore &Store() { return calendar_store_; }
+  const CalendarStore &Store() const { return calendar_store_; }
+
+protected:
+  virtual CalendarEvent *CreateCalendarEventInto(void *storage, const CalendarEntryRecord &record) const = 0;
+  virtual std::size_t CalendarEventSize() const = 0;
+  virtual std::size_t CalendarEventAlignment() const = 0;
+
+private:
+  CalendarStore calendar_store_;
+  CalendarArena calendar_arena_;
 };
 
 /**
@@ -151,6 +816,15 @@ public:
   {
     return new GoogleReminderItem(calender_entry);
   }
+
+protected:
+  typedef ConcreteCalendarEvent<GoogleCalendarEntry, GoogleReminderItem> Event;
+  CalendarEvent *CreateCalendarEventInto(void *storage, const CalendarEntryRecord &record) const override
+  {
+    return new (storage) Event(record);
+  }
+  std::size_t CalendarEventSize() const override { return sizeof(Event); }
+  std::size_t CalendarEventAlignment() const override { return alignof(Event); }
 };
 
 /**
@@ -167,6 +841,15 @@ public:
   {
     return new OutlookReminderItem(calender_entry);
   }
+
+protected:
+  typedef ConcreteCalendarEvent<OutlookCalendarEntry, OutlookReminderItem> Event;
+  CalendarEvent *CreateCalendarEventInto(void *storage, const CalendarEntryRecord &record) const override
+  {
+    return new (storage) Event(record);
+  }
+  std::size_t CalendarEventSize() const override { return sizeof(Event); }
+  std::size_t CalendarEventAlignment() const override { return alignof(Event); }
 };
 
 /**
@@ -183,22 +866,1507 @@ public:
   {
     return new LocalReminderItem(calender_entry);
   }
+
+protected:
+  typedef ConcreteCalendarEvent<LocalCalendarEntry, LocalReminderItem> Event;
+  CalendarEvent *CreateCalendarEventInto(void *storage, const CalendarEntryRecord &record) const override
+  {
+    return new (storage) Event(record);
+  }
+  std::size_t CalendarEventSize() const override { return sizeof(Event); }
+  std::size_t CalendarEventAlignment() const override { return alignof(Event); }
+};
+
+/**
+ * Memory-mapped read-only file, used by the iCalendar reader to parse without copying the file.
+ */
+class MappedFile
+{
+public:
+  explicit MappedFile(const std::string &path)
+  {
+#if defined(__unix__) || defined(__APPLE__)
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+      throw std::runtime_error("Cannot open " + path);
+    }
+    struct stat file_status;
+    if (fstat(file, &file_status) != 0)
+    {
+      close(file);
+      throw std::runtime_error("Cannot stat " + path);
+    }
+    size_ = static_cast<std::size_t>(file_status.st_size);
+    if (size_ > 0)
+    {
+      void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+      if (data == MAP_FAILED)
+      {
+        close(file);
+        throw std::runtime_error("Cannot map " + path);
+      }
+      madvise(data, size_, MADV_SEQUENTIAL);
+      data_ = static_cast<const char *>(data);
+    }
+    close(file);
+#else
+    throw std::runtime_error("Memory-mapped files are not supported on this platform: " + path);
+#endif
+  }
+
+  MappedFile(const MappedFile &other) = delete;
+  void operator=(const MappedFile &) = delete;
+
+  ~MappedFile()
+  {
+#if defined(__unix__) || defined(__APPLE__)
+    if (data_ != nullptr)
+    {
+      munmap(const_cast<char *>(data_), size_);
+    }
+#endif
+  }
+
+  std::string_view View() const { return std::string_view(data_, size_); }
+
+private:
+  const char *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+/**
+ * Streaming iCalendar (.ics) reader. It walks the mapped file line by line and turns every VEVENT
+ * into a calendar entry record. Field values are views into the mapping; only new titles are
+ * copied when they are interned. Records are handed out in batches of fixed size, and the cache of
+ * title ids holds at most kMaxCachedTitles titles, so the memory used by the reader itself does
+ * not depend on the size of the file. Every distinct title still takes one entry in the TitleTable
+ * shared by the stores.
+ *
+ * Times are read as UTC epoch minutes, the time base of the store. Values in UTC ("...Z") and
+ * floating values are taken as they are. The reader has no time zone rules, so a value with a TZID
+ * other than UTC is taken as UTC as well; ZonedTimeCount tells how many values were read that way.
+ * A date outside [kMinYear, kMaxYear], a field out of range and a negative DURATION are rejected
+ * with std::invalid_argument.
+ */
+class ICalendarReader
+{
+public:
+  explicit ICalendarReader(const std::string &path) : file_(path) {}
+
+  // calls consume(const std::vector<CalendarEntryRecord> &) per batch, returns the number of entries
+  template <typename Consumer>
+  std::size_t ReadBatches(std::size_t batch_size, Consumer consume)
+  {
+    std::string_view text = file_.View();
+    std::vector<CalendarEntryRecord> batch;
+    batch.reserve(batch_size);
+    std::size_t entry_count = 0;
+    bool in_event = false;
+    bool has_end = false;
+    std::int32_t end_minute = 0;
+    CalendarEntryRecord record = {0, 0, 0};
+    std::string_view summary;
+    std::string unfolded_summary;
+
+    // one property with its folded continuation lines, which are unfolded into unfolded_property
+    // only for the properties the reader stores
+    auto read_property = [&](std::string_view property)
+    {
+      std::size_t colon = property.find(':');
+      if (colon == std::string_view::npos)
+      {
+        return;
+      }
+      std::string_view name = PropertyName(property);
+      std::string_view parameters = property.substr(name.size(), colon - name.size());
+      std::string_view value = property.substr(colon + 1);
+
+      if (name == "BEGIN" && value == "VEVENT")
+      {
+        in_event = true;
+        has_end = false;
+        record = {0, -1, 0};
+        summary = std::string_view();
+      }
+      else if (!in_event)
+      {
+        return;
+      }
+      else if (name == "DTSTART")
+      {
+        record.start_minute = this->ParseDateTime(value, parameters);
+      }
+      else if (name == "DTEND")
+      {
+        end_minute = this->ParseDateTime(value, parameters);
+        has_end = true;
+      }
+      else if (name == "DURATION")
+      {
+        record.duration_minutes = ParseIcsDuration(value);
+      }
+      else if (name == "SUMMARY")
+      {
+        if (value.data() >= text.data() && value.data() < text.data() + text.size())
+        {
+          summary = value;
+        }
+        else
+        {
+          unfolded_summary.assign(value);
+          summary = unfolded_summary;
+        }
+      }
+      else if (name == "END" && value == "VEVENT")
+      {
+        in_event = false;
+        if (record.duration_minutes < 0)
+        {
+          record.duration_minutes = has_end ? end_minute - record.start_minute : 0;
+        }
+        record.title_id = this->InternTitle(summary);
+        batch.push_back(record);
+        entry_count++;
+        if (batch.size() == batch_size)
+        {
+          consume(static_cast<const std::vector<CalendarEntryRecord> &>(batch));
+          batch.clear();
+        }
+      }
+    };
+
+    std::string_view property;
+    std::string unfolded_property;
+    std::size_t position = 0;
+    while (position < text.size())
+    {
+      std::size_t line_end = text.find('\n', position);
+      if (line_end == std::string_view::npos)
+      {
+        line_end = text.size();
+      }
+      std::string_view line = text.substr(position, line_end - position);
+      position = line_end + 1;
+      if (!line.empty() && line.back() == '\r')
+      {
+        line.remove_suffix(1);
+      }
+
+      // folded line: continuation of the property before it, dropped for properties not stored
+      if (!line.empty() && (line.front() == ' ' || line.front() == '\t'))
+      {
+        if (in_event && IsStoredProperty(PropertyName(property)))
+        {
+          if (property.data() != unfolded_property.data())
+          {
+            unfolded_property.assign(property);
+          }
+          unfolded_property.append(line.substr(1));
+          property = unfolded_property;
+        }
+        continue;
+      }
+      read_property(property);
+      property = line;
+    }
+    read_property(property);
+    if (!batch.empty())
+    {
+      consume(static_cast<const std::vector<CalendarEntryRecord> &>(batch));
+    }
+    return entry_count;
+  }
+
+  // number of times with a TZID the reader has no rules for, which were read as UTC
+  std::size_t ZonedTimeCount() const { return zoned_time_count_; }
+
+private:
+  MappedFile file_;
+  static constexpr std::size_t kMaxCachedTitles = 4096;
+  // keys point into the mapping or into unfolded_titles_, a deque, so that they stay valid
+  // when further titles are added
+  std::unordered_map<std::string_view, std::uint32_t> title_ids_;
+  std::deque<std::string> unfolded_titles_;  // keys of titles not in the mapping
+  std::size_t zoned_time_count_ = 0;
+
+  static std::string_view PropertyName(std::string_view property)
+  {
+    return property.substr(0, std::min(property.find(':'), property.find(';')));
+  }
+
+  static bool IsStoredProperty(std::string_view name)
+  {
+    return name == "DTSTART" || name == "DTEND" || name == "DURATION" || name == "SUMMARY";
+  }
+
+  static int Digits(std::string_view text, std::size_t offset, std::size_t count)
+  {
+    int value = 0;
+    for (std::size_t i = offset; i < offset + count; i++)
+    {
+      if (i >= text.size() || text[i] < '0' || text[i] > '9')
+      {
+        throw std::invalid_argument("Invalid iCalendar date: " + std::string(text));
+      }
+      value = value * 10 + (text[i] - '0');
+    }
+    return value;
+  }
+
+  // "20240503T103000", "20240503T103000Z" or "20240503" (all-day), parameters such as ";TZID=Europe/Berlin"
+  std::int32_t ParseDateTime(std::string_view value, std::string_view parameters)
+  {
+    std::size_t zone = parameters.find(";TZID=");
+    if (zone != std::string_view::npos)
+    {
+      std::string_view zone_name = parameters.substr(zone + 6, parameters.find(';', zone + 6) - (zone + 6));
+      if (zone_name != "UTC" && zone_name != "Etc/UTC" && zone_name != "GMT")
+      {
+        zoned_time_count_++;
+      }
+    }
+    const int year = Digits(value, 0, 4), month = Digits(value, 4, 2), day = Digits(value, 6, 2);
+    int hour = 0, minute = 0, second = 0;
+    const bool has_time = value.size() > 8;
+    if (has_time)
+    {
+      if (value[8] != 'T' || (value.size() != 15 && !(value.size() == 16 && value[15] == 'Z')))
+      {
+        throw std::invalid_argument("Invalid iCalendar date: " + std::string(value));
+      }
+      hour = Digits(value, 9, 2);
+      minute = Digits(value, 11, 2);
+      second = Digits(value, 13, 2);
+    }
+    if (year < calendar_time::kMinYear || year > calendar_time::kMaxYear || month < 1 || month > 12 ||
+        day < 1 || day > calendar_time::DaysInMonth(year, month) || hour > 23 || minute > 59 || second > 60)
+    {
+      throw std::invalid_argument("Invalid iCalendar date: " + std::string(value));
+    }
+    return calendar_time::DaysFromCivil(year, month, day) * 1440 + hour * 60 + minute;
+  }
+
+  // "PT1H30M", "P1D", "P1W", "P1DT2H", "+PT15M"; seconds are dropped. A negative duration would
+  // end the entry before it starts and is rejected, as is one over kMaxDurationMinutes.
+  static std::int32_t ParseIcsDuration(std::string_view value)
+  {
+    std::string_view text = value;
+    if (!text.empty() && text.front() == '+')
+    {
+      text.remove_prefix(1);
+    }
+    if (text.empty() || text.front() != 'P')
+    {
+      throw std::invalid_argument("Invalid iCalendar duration: " + std::string(value));
+    }
+    std::int64_t minutes = 0;
+    std::int64_t number = 0;
+    bool has_number = false;
+    bool in_time = false;
+    for (char c : text.substr(1))
+    {
+      if (c >= '0' && c <= '9')
+      {
+        number = number * 10 + (c - '0');
+        has_number = true;
+        if (number > calendar_time::kMaxDurationMinutes)
+        {
+          break;
+        }
+        continue;
+      }
+      if (c == 'T' && !in_time && !has_number)
+      {
+        in_time = true;
+        continue;
+      }
+      // weeks and days before the 'T', hours, minutes and seconds after it
+      const bool date_unit = c == 'W' || c == 'D';
+      const bool time_unit = c == 'H' || c == 'M' || c == 'S';
+      if (!has_number || (date_unit && in_time) || (time_unit && !in_time) || (!date_unit && !time_unit))
+      {
+        throw std::invalid_argument("Invalid iCalendar duration: " + std::string(value));
+      }
+      switch (c)
+      {
+      case 'W': minutes += number * 7 * 1440; break;
+      case 'D': minutes += number * 1440; break;
+      case 'H': minutes += number * 60; break;
+      case 'M': minutes += number; break;
+      default: break;
+      }
+      number = 0;
+      has_number = false;
+    }
+    if (has_number || minutes > calendar_time::kMaxDurationMinutes || number > calendar_time::kMaxDurationMinutes)
+    {
+      throw std::invalid_argument("Invalid iCalendar duration: " + std::string(value));
+    }
+    return static_cast<std::int32_t>(minutes);
+  }
+
+  std::uint32_t InternTitle(std::string_view summary)
+  {
+    std::unordered_map<std::string_view, std::uint32_t>::const_iterator id = title_ids_.find(summary);
+    if (id != title_ids_.end())
+    {
+      return id->second;
+    }
+    if (title_ids_.size() == kMaxCachedTitles)
+    {
+      title_ids_.clear();
+      unfolded_titles_.clear();
+    }
+    std::string title = Unescape(summary);
+    std::uint32_t title_id = TitleTable::Instance().Intern(title);
+    std::string_view file_text = file_.View();
+    if (summary.data() >= file_text.data() && summary.data() < file_text.data() + file_text.size())
+    {
+      title_ids_[summary] = title_id;
+    }
+    else
+    {
+      unfolded_titles_.push_back(std::string(summary));
+      title_ids_[unfolded_titles_.back()] = title_id;
+    }
+    return title_id;
+  }
+
+  static std::string Unescape(std::string_view text)
+  {
+    std::string result;
+    result.reserve(text.size());
+    for (std::size_t i = 0; i < text.size(); i++)
+    {
+      if (text[i] == '\\' && i + 1 < text.size())
+      {
+        i++;
+        result.push_back(text[i] == 'n' || text[i] == 'N' ? '\n' : text[i]);
+      }
+      else
+      {
+        result.push_back(text[i]);
+      }
+    }
+    return result;
+  }
+};
+
+/**
+ * Streaming iCalendar writer. Entries are formatted into a fixed buffer which is flushed to the
+ * file whenever it is full. Times are written in UTC ("...Z"), the time base of the store, and
+ * DTSTAMP is the time of the export. Lines longer than 75 octets are folded as RFC 5545 requires.
+ *
+ * Write and Close throw when the file cannot be written. The destructor closes a writer that was
+ * not closed, but swallows the error, so call Close to find out whether the file is complete.
+ */
+class ICalendarWriter
+{
+public:
+  explicit ICalendarWriter(const std::string &path) : file_(std::fopen(path.c_str(), "wb"))
+  {
+    if (file_ == nullptr)
+    {
+      throw std::runtime_error("Cannot open " + path);
+    }
+    buffer_.reserve(kBufferSize);
+    buffer_ += "BEGIN:VCALENDAR\r\nVERSION:2.0\r\nPRODID:-//design-patterns//calendar//EN\r\n";
+    const std::int64_t now_minute = std::chrono::duration_cast<std::chrono::minutes>(std::chrono::system_clock::now().time_since_epoch()).count();
+    stamp_line_ = "\r\nDTSTAMP:";
+    AppendDateTime(stamp_line_, static_cast<std::int32_t>(now_minute));
+  }
+
+  ICalendarWriter(const ICalendarWriter &other) = delete;
+  void operator=(const ICalendarWriter &) = delete;
+
+  ~ICalendarWriter()
+  {
+    try
+    {
+      this->Close();
+    }
+    catch (const std::exception &)
+    {
+      // the destructor must not throw; an explicit Close reports the error
+    }
+  }
+
+  void Write(const CalendarEntryRecord &record)
+  {
+    char line[64];
+    int length = std::snprintf(line, sizeof(line), "BEGIN:VEVENT\r\nUID:%zu@design-patterns", entry_count_++);
+    buffer_.append(line, length);
+    buffer_ += stamp_line_;
+    buffer_ += "\r\nDTSTART:";
+    AppendDateTime(buffer_, record.start_minute);
+    buffer_ += "\r\nDTEND:";
+    AppendDateTime(buffer_, record.EndMinute());
+    buffer_ += "\r\n";
+    if (record.title_id != cached_title_id_)
+    {
+      cached_title_id_ = record.title_id;
+      cached_summary_line_ = FoldLine("SUMMARY:" + Escape(TitleTable::Instance().Title(record.title_id)));
+    }
+    buffer_ += cached_summary_line_;
+    buffer_ += "\r\nEND:VEVENT\r\n";
+    // room for the next entry: its fixed lines take less than 512 octets
+    if (buffer_.size() + 512 + cached_summary_line_.size() > kBufferSize)
+    {
+      this->Flush();
+    }
+  }
+
+  // the file is closed even when the last write fails, a second Close does nothing
+  void Close()
+  {
+    if (file_ == nullptr)
+    {
+      return;
+    }
+    buffer_ += "END:VCALENDAR\r\n";
+    const bool written = std::fwrite(buffer_.data(), 1, buffer_.size(), file_) == buffer_.size();
+    buffer_.clear();
+    const bool closed = std::fclose(file_) == 0;
+    file_ = nullptr;
+    if (!written || !closed)
+    {
+      throw std::runtime_error("Cannot write iCalendar file");
+    }
+  }
+
+private:
+  static constexpr std::size_t kBufferSize = 1 << 20;
+  static constexpr std::size_t kMaxLineOctets = 75;
+  std::FILE *file_;
+  std::string buffer_;
+  std::string stamp_line_;
+  std::size_t entry_count_ = 0;
+  std::uint32_t cached_title_id_ = UINT32_MAX;
+  std::string cached_summary_line_;
+
+  void Flush()
+  {
+    if (std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size())
+    {
+      throw std::runtime_error("Cannot write iCalendar file");
+    }
+    buffer_.clear();
+  }
+
+  static void AppendDateTime(std::string &text_buffer, std::int32_t epoch_minute)
+  {
+    std::int32_t days = epoch_minute >= 0 ? epoch_minute / 1440 : -((-epoch_minute + 1439) / 1440);
+    std::int32_t minute_of_day = epoch_minute - days * 1440;
+    int year = 0, month = 0, day = 0;
+    calendar_time::CivilFromDays(days, year, month, day);
+    char text[24];
+    int length = std::snprintf(text, sizeof(text), "%04d%02d%02dT%02d%02d00Z", year, month, day, minute_of_day / 60, minute_of_day % 60);
+    text_buffer.append(text, length);
+  }
+
+  // breaks the line into pieces of at most 75 octets, every continuation starting with a space,
+  // without splitting a UTF-8 sequence
+  static std::string FoldLine(const std::string &line)
+  {
+    std::string folded;
+    std::size_t begin = 0;
+    std::size_t limit = kMaxLineOctets;
+    while (line.size() - begin > limit)
+    {
+      std::size_t end = begin + limit;
+      while (end > begin + 1 && (static_cast<unsigned char>(line[end]) & 0xC0) == 0x80)
+      {
+        end--;
+      }
+      folded.append(line, begin, end - begin);
+      folded += "\r\n ";
+      begin = end;
+      limit = kMaxLineOctets - 1;
+    }
+    folded.append(line, begin, std::string::npos);
+    return folded;
+  }
+
+  static std::string Escape(const std::string &text)
+  {
+    std::string result;
+    for (char c : text)
+    {
+      if (c == '\\' || c == ';' || c == ',')
+      {
+        result.push_back('\\');
+        result.push_back(c);
+      }
+      else if (c == '\n')
+      {
+        result += "\\n";
+      }
+      else
+      {
+        result.push_back(c);
+      }
+    }
+    return result;
+  }
+};
+
+/**
+ * Bulk import of an .ics file into the store of any calendar system, and export of the store.
+ */
+std::size_t ImportICalendar(const std::string &path, CalendarSystem &calendar_system, std::size_t batch_size = 65536)
+{
+  ICalendarReader reader(path);
+  std::size_t entry_count = reader.ReadBatches(batch_size, [&calendar_system](const std::vector<CalendarEntryRecord> &batch)
+                                               { calendar_system.Store().Add(batch); });
+  if (reader.ZonedTimeCount() > 0)
+  {
+    std::cerr << "Read " << reader.ZonedTimeCount() << " times with a time zone other than UTC as UTC\n";
+  }
+  return entry_count;
+}
+
+std::size_t ExportICalendar(const CalendarSystem &calendar_system, const std::string &path)
+{
+  ICalendarWriter writer(path);
+  std::size_t entry_count = 0;
+  calendar_system.Store().ForEach([&](const CalendarEntryRecord &record)
+                                  { writer.Write(record); entry_count++; });
+  writer.Close();
+  return entry_count;
+}
+
+/**
+ * Synchronization with remote calendars (Google, Outlook). A change of an entry is a sync
+ * operation; the backend receives them in batches and acknowledges each batch asynchronously.
+ */
+struct SyncOperation
+{
+  enum Kind
+  {
+    UPSERT,
+    REMOVE
+  };
+  Kind kind;
+  std::uint64_t entry_id;
+  CalendarEntryRecord record;
+};
+
+class CalendarBackend
+{
+public:
+  virtual ~CalendarBackend() {}
+  // sends a batch, on_done is called once the backend has applied it; batches are applied in order
+  virtual void Send(std::vector<SyncOperation> batch, std::function<void()> on_done) = 0;
+};
+
+/**
+ * Local mock of a remote calendar backend. Every request is applied one round trip after it was
+ * sent; requests do not wait for each other, so several of them can be in flight.
+ */
+class MockCalendarBackend : public CalendarBackend
+{
+public:
+  explicit MockCalendarBackend(std::chrono::microseconds round_trip) : round_trip_(round_trip), delivery_thread_(&MockCalendarBackend::Deliver, this) {}
+
+  MockCalendarBackend(const MockCalendarBackend &other) = delete;
+  void operator=(const MockCalendarBackend &) = delete;
+
+  ~MockCalendarBackend()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    changed_.notify_one();
+    delivery_thread_.join();
+  }
+
+  void Send(std::vector<SyncOperation> batch, std::function<void()> on_done) override
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      requests_.push_back({std::chrono::steady_clock::now() + round_trip_, std::move(batch), std::move(on_done)});
+      request_count_++;
+    }
+    changed_.notify_one();
+  }
+
+  std::size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+  bool Find(std::uint64_t entry_id, CalendarEntryRecord &record) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unordered_map<std::uint64_t, CalendarEntryRecord>::const_iterator entry = entries_.find(entry_id);
+    if (entry == entries_.end())
+    {
+      return false;
+    }
+    record = entry->second;
+    return true;
+  }
+
+  std::size_t RequestCount() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return request_count_;
+  }
+
+private:
+  struct Request
+  {
+    std::chrono::steady_clock::time_point due;
+    std::vector<SyncOperation> batch;
+    std::function<void()> on_done;
+  };
+
+  const std::chrono::microseconds round_trip_;
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<Request> requests_;  // due in the order they were sent
+  std::unordered_map<std::uint64_t, CalendarEntryRecord> entries_;
+  std::size_t request_count_ = 0;
+  bool stopping_ = false;
+  std::thread delivery_thread_;
+
+  void Deliver()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      changed_.wait(lock, [this]
+                    { return stopping_ || !requests_.empty(); });
+      if (requests_.empty())
+      {
+        return;
+      }
+      std::chrono::steady_clock::time_point due = requests_.front().due;
+      lock.unlock();
+      std::this_thread::sleep_until(due);
+      lock.lock();
+      Request request = std::move(requests_.front());
+      requests_.pop_front();
+      for (const SyncOperation &operation : request.batch)
+      {
+        if (operation.kind == SyncOperation::UPSERT)
+        {
+          entries_[operation.entry_id] = operation.record;
+        }
+        else
+        {
+          entries_.erase(operation.entry_id);
+        }
+      }
+      lock.unlock();
+      request.on_done();
+      lock.lock();
+    }
+  }
+};
+
+struct SyncStatistics
+{
+  std::size_t submitted = 0;  // operations given to the engine
+  std::size_t coalesced = 0;  // operations replaced by a later one for the same entry
+  std::size_t sent = 0;       // operations sent to the backend
+  std::size_t batches = 0;    // requests sent to the backend
+};
+
+/**
+ * Sync engine between a calendar system and its backend. Changes are queued and sent by a
+ * background thread in batches of up to max_batch_size operations, with up to max_in_flight
+ * batches awaiting acknowledgement at the same time. A change to an entry that is still queued
+ * replaces the queued operation, so an entry updated repeatedly is sent once.
+ */
+class CalendarSyncEngine
+{
+public:
+  // both limits must be at least 1, otherwise std::invalid_argument is thrown
+  CalendarSyncEngine(CalendarBackend &backend, std::size_t max_batch_size = 256, std::size_t max_in_flight = 8)
+      : backend_(backend), max_batch_size_(RequirePositive(max_batch_size, "max_batch_size")),
+        max_in_flight_(RequirePositive(max_in_flight, "max_in_flight")), sender_thread_(&CalendarSyncEngine::Run, this) {}
+
+  CalendarSyncEngine(const CalendarSyncEngine &other) = delete;
+  void operator=(const CalendarSyncEngine &) = delete;
+
+  ~CalendarSyncEngine()
+  {
+    this->Flush();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    changed_.notify_all();
+    sender_thread_.join();
+  }
+
+  void Upsert(std::uint64_t entry_id, const CalendarEntryRecord &record)
+  {
+    this->Submit({SyncOperation::UPSERT, entry_id, record});
+  }
+
+  void Remove(std::uint64_t entry_id)
+  {
+    this->Submit({SyncOperation::REMOVE, entry_id, {0, 0, 0}});
+  }
+
+  // waits until every submitted operation is acknowledged by the backend
+  void Flush()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this]
+                  { return unacknowledged_ == 0; });
+  }
+
+  SyncStatistics Statistics() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return statistics_;
+  }
+
+private:
+  CalendarBackend &backend_;
+  const std::size_t max_batch_size_;
+  const std::size_t max_in_flight_;
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::vector<SyncOperation> pending_;
+  std::unordered_map<std::uint64_t, std::size_t> pending_index_;  // entry id -> position in pending_
+  std::size_t unacknowledged_ = 0;
+  std::size_t in_flight_ = 0;
+  bool stopping_ = false;
+  SyncStatistics statistics_;
+  std::thread sender_thread_;
+
+  static std::size_t RequirePositive(std::size_t value, const char *name)
+  {
+    if (value == 0)
+    {
+      throw std::invalid_argument(std::string("CalendarSyncEngine: ") + name + " must be at least 1");
+    }
+    return value;
+  }
+
+  void Submit(const SyncOperation &operation)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      statistics_.submitted++;
+      std::unordered_map<std::uint64_t, std::size_t>::const_iterator queued = pending_index_.find(operation.entry_id);
+      if (queued != pending_index_.end())
+      {
+        pending_[queued->second] = operation;
+        statistics_.coalesced++;
+        return;
+      }
+      pending_index_[operation.entry_id] = pending_.size();
+      pending_.push_back(operation);
+      unacknowledged_++;
+    }
+    changed_.notify_all();
+  }
+
+  void Run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      changed_.wait(lock, [this]
+                    { return stopping_ || !pending_.empty(); });
+      if (pending_.empty())
+      {
+        return;
+      }
+      // later changes go to a new queue and are coalesced there while this one is sent
+      std::vector<SyncOperation> operations;
+      operations.swap(pending_);
+      pending_index_.clear();
+      for (std::size_t first = 0; first < operations.size(); first += max_batch_size_)
+      {
+        changed_.wait(lock, [this]
+                      { return in_flight_ < max_in_flight_; });
+        std::size_t last = std::min(first + max_batch_size_, operations.size());
+        std::vector<SyncOperation> batch(operations.begin() + first, operations.begin() + last);
+        std::size_t batch_size = batch.size();
+        in_flight_++;
+        statistics_.sent += batch_size;
+        statistics_.batches++;
+        lock.unlock();
+        backend_.Send(std::move(batch), [this, batch_size]
+                      { this->Acknowledge(batch_size); });
+        lock.lock();
+      }
+    }
+  }
+
+  void Acknowledge(std::size_t batch_size)
+  {
+    // notified under the lock: once Flush sees the last acknowledgement the engine may be destroyed
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_--;
+    unacknowledged_ -= batch_size;
+    changed_.notify_all();
+  }
+};
+
+/**
+ * Reminder scheduler fires reminder items when they are due. Pending reminders are kept in a
+ * hierarchical timer wheel of 1 ms ticks: four levels of 256 slots cover 2^32 ticks (about 49
+ * days), and reminders further away wait in an overflow list. Every slot is an intrusive doubly
+ * linked list over a node pool, so scheduling and cancelling are O(1); a reminder moves down one
+ * level at a time as its due tick comes closer.
+ *
+ * A dispatch thread advances the wheel once per tick and calls on_fire with every due reminder
+ * and how late it fired. The callback runs without the lock held and may schedule or cancel.
+ * Reminders collected for a tick stay cancellable until their callback starts. A Cancel from
+ * another thread that meets the callback of its reminder running waits for it to return, so once
+ * Cancel has returned on_fire no longer uses the reminder item, which may then be destroyed.
+ * Reminder items must stay alive until they are fired or cancelled.
+ */
+class ReminderScheduler
+{
+public:
+  typedef std::uint64_t Handle;
+  typedef std::function<void(const ReminderItem &, std::chrono::steady_clock::duration)> FireCallback;
+
+  explicit ReminderScheduler(FireCallback on_fire)
+      : on_fire_(std::move(on_fire)), start_(std::chrono::steady_clock::now()), heads_(kLevels * kSlots + 1, kNil),
+        dispatch_thread_(&ReminderScheduler::Dispatch, this) {}
+
+  ReminderScheduler(const ReminderScheduler &other) = delete;
+  void operator=(const ReminderScheduler &) = delete;
+
+  ~ReminderScheduler()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    changed_.notify_one();
+    dispatch_thread_.join();
+  }
+
+  Handle Schedule(const ReminderItem &reminder, std::chrono::steady_clock::time_point due)
+  {
+    std::int64_t due_tick = (std::chrono::duration_cast<std::chrono::microseconds>(due - start_).count() + 999) / 1000;
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::uint32_t index = free_head_;
+    if (index == kNil)
+    {
+      index = static_cast<std::uint32_t>(nodes_.size());
+      nodes_.push_back(TimerNode());
+    }
+    else
+    {
+      free_head_ = nodes_[index].next;
+    }
+    TimerNode &node = nodes_[index];
+    node.due_tick = std::max(due_tick, current_tick_ + 1);
+    node.reminder = &reminder;
+    this->Link(index);
+    pending_count_++;
+    return this->HandleOf(index);
+  }
+
+  // fires at the start minute of the reminder, read as UTC
+  Handle Schedule(const ReminderItem &reminder)
+  {
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::time_point(std::chrono::minutes(reminder.start_minute));
+    return this->Schedule(reminder, std::chrono::steady_clock::now() + (start - std::chrono::system_clock::now()));
+  }
+
+  // returns false when the reminder has already fired, is firing or was cancelled
+  bool Cancel(Handle handle)
+  {
+    std::uint32_t index = static_cast<std::uint32_t>(handle);
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (index >= nodes_.size() || nodes_[index].generation != static_cast<std::uint32_t>(handle >> 32) || nodes_[index].slot == kNil)
+    {
+      if (handle == firing_handle_ && std::this_thread::get_id() != dispatch_thread_.get_id())
+      {
+        fired_.wait(lock, [this, handle]() { return firing_handle_ != handle; });
+      }
+      return false;
+    }
+    if (nodes_[index].slot == kFiringSlot)
+    {
+      nodes_[index].slot = kNil;  // collected for the current tick, Dispatch skips it
+    }
+    else
+    {
+      this->Unlink(index);
+      pending_count_--;
+    }
+    this->Free(index);
+    return true;
+  }
+
+  std::size_t PendingCount() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_count_;
+  }
+
+private:
+  static constexpr int kLevels = 4;
+  static constexpr int kSlotBits = 8;
+  static constexpr std::uint32_t kSlots = 1 << kSlotBits;
+  static constexpr std::uint32_t kOverflowSlot = kLevels * kSlots;
+  static constexpr std::uint32_t kFiringSlot = kOverflowSlot + 1;  // collected, callback not started yet
+  static constexpr std::uint32_t kNil = UINT32_MAX;
+  static constexpr Handle kNoHandle = UINT64_MAX;
+
+  struct TimerNode
+  {
+    std::int64_t due_tick = 0;
+    const ReminderItem *reminder = nullptr;
+    std::uint32_t prev = kNil;
+    std::uint32_t next = kNil;
+    std::uint32_t slot = kNil;  // kNil while the node is free, kFiringSlot once collected
+    std::uint32_t generation = 0;
+  };
+
+  FireCallback on_fire_;
+  const std::chrono::steady_clock::time_point start_;
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::condition_variable fired_;
+  std::vector<TimerNode> nodes_;
+  std::vector<std::uint32_t> heads_;  // first node of every slot, the overflow list last
+  std::uint32_t free_head_ = kNil;
+  std::int64_t current_tick_ = 0;     // every reminder due up to this tick has fired
+  std::size_t pending_count_ = 0;     // reminders in the wheel, not yet collected
+  Handle firing_handle_ = kNoHandle;  // reminder whose callback runs right now
+  bool stopping_ = false;
+  std::thread dispatch_thread_;
+
+  Handle HandleOf(std::uint32_t index) const
+  {
+    return (static_cast<Handle>(nodes_[index].generation) << 32) | index;
+  }
+
+  // the lowest level whose current block also contains the due tick
+  std::uint32_t SlotOf(std::int64_t due_tick) const
+  {
+    for (int level = 0; level < kLevels; level++)
+    {
+      int block_shift = kSlotBits * (level + 1);
+      if ((due_tick >> block_shift) == (current_tick_ >> block_shift))
+      {
+        return level * kSlots + static_cast<std::uint32_t>((due_tick >> (kSlotBits * level)) & (kSlots - 1));
+      }
+    }
+    return kOverflowSlot;
+  }
+
+  void Link(std::uint32_t index)
+  {
+    TimerNode &node = nodes_[index];
+    node.slot = this->SlotOf(node.due_tick);
+    node.prev = kNil;
+    node.next = heads_[node.slot];
+    if (node.next != kNil)
+    {
+      nodes_[node.next].prev = index;
+    }
+    heads_[node.slot] = index;
+  }
+
+  void Unlink(std::uint32_t index)
+  {
+    TimerNode &node = nodes_[index];
+    if (node.prev != kNil)
+    {
+      nodes_[node.prev].next = node.next;
+    }
+    else
+    {
+      heads_[node.slot] = node.next;
+    }
+    if (node.next != kNil)
+    {
+      nodes_[node.next].prev = node.prev;
+    }
+    node.slot = kNil;
+  }
+
+  void Free(std::uint32_t index)
+  {
+    TimerNode &node = nodes_[index];
+    node.generation++;
+    node.reminder = nullptr;
+    node.next = free_head_;
+    free_head_ = index;
+  }
+
+  // moves every reminder of a slot to the level its due tick belongs to now
+  void Cascade(std::uint32_t slot)
+  {
+    std::uint32_t index = heads_[slot];
+    heads_[slot] = kNil;
+    while (index != kNil)
+    {
+      std::uint32_t next = nodes_[index].next;
+      this->Link(index);
+      index = next;
+    }
+  }
+
+  // advances the wheel by one tick and collects the reminders due at it, which stay allocated
+  // (and cancellable) until Dispatch fires them
+  void Advance(std::vector<std::uint32_t> &due)
+  {
+    current_tick_++;
+    if ((current_tick_ & ((std::int64_t(1) << (kSlotBits * kLevels)) - 1)) == 0)
+    {
+      this->Cascade(kOverflowSlot);
+    }
+    for (int level = kLevels - 1; level > 0; level--)
+    {
+      if ((current_tick_ & ((std::int64_t(1) << (kSlotBits * level)) - 1)) == 0)
+      {
+        this->Cascade(level * kSlots + static_cast<std::uint32_t>((current_tick_ >> (kSlotBits * level)) & (kSlots - 1)));
+      }
+    }
+    std::uint32_t slot = static_cast<std::uint32_t>(current_tick_ & (kSlots - 1));
+    std::uint32_t index = heads_[slot];
+    heads_[slot] = kNil;
+    while (index != kNil)
+    {
+      std::uint32_t next = nodes_[index].next;
+      due.push_back(index);
+      nodes_[index].slot = kFiringSlot;
+      pending_count_--;
+      index = next;
+    }
+  }
+
+  void Dispatch()
+  {
+    std::vector<std::uint32_t> due;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
+    {
+      std::int64_t now_tick = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_).count();
+      if (pending_count_ == 0)
+      {
+        current_tick_ = std::max(current_tick_, now_tick);
+      }
+      while (current_tick_ < now_tick && due.empty())
+      {
+        this->Advance(due);
+      }
+      if (!due.empty())
+      {
+        const std::chrono::steady_clock::time_point due_time = start_ + std::chrono::milliseconds(current_tick_);
+        for (std::uint32_t index : due)
+        {
+          if (nodes_[index].slot != kFiringSlot)
+          {
+            continue;  // cancelled after it was collected
+          }
+          const ReminderItem *reminder = nodes_[index].reminder;
+          firing_handle_ = this->HandleOf(index);
+          nodes_[index].slot = kNil;
+          this->Free(index);
+          lock.unlock();
+          on_fire_(*reminder, std::chrono::steady_clock::now() - due_time);
+          lock.lock();
+          firing_handle_ = kNoHandle;
+          fired_.notify_all();
+        }
+        due.clear();
+        continue;
+      }
+      changed_.wait_until(lock, start_ + std::chrono::milliseconds(current_tick_ + 1));
+    }
+  }
 };
 
 /**
  * Client code works with factory interface ("CalendarSystem") and product
  * interface ("CalendarEntry" and "ReminderItem").
  */
-void ClientCode(const CalendarSystem &calendar_system)
+void ClientCode(CalendarSystem &calendar_system)
+{
+  CalendarEventPtr calendar_event = calendar_system.CreateCalendarEvent("Project meeting", "03.05.2024", "10:30 a.m.", "1 hour");
+  calendar_event->Entry().ShowCalendarEntryInfo();
+  calendar_event->Reminder().ShowReminderItemInfo();
+
+  calendar_system.Store().Add(calendar_event->Entry().record);
+  std::unique_ptr<const CalendarEntry> lunch_entry(calendar_system.CreateCalendarEntry("Lunch", "03.05.2024", "12:00 p.m.", "45 minutes"));
+  calendar_system.Store().Add(lunch_entry->record);
+
+  std::unique_ptr<const CalendarEntry> new_entry(calendar_system.CreateCalendarEntry("Design review", "03.05.2024", "11:00 a.m.", "1 hour"));
+  for (const CalendarEntryRecord &conflict : calendar_system.Store().FindConflicts(new_entry->record))
+  {
+    std::cout << "Conflict: " << TitleTable::Instance().Title(conflict.title_id) << " at " << calendar_time::FormatTime(conflict.start_minute) << "\n";
+  }
+  const std::int32_t day_start = calendar_time::ParseDate("03.05.2024") * 1440;
+  for (const std::pair<std::int32_t, std::int32_t> &free_slot : calendar_system.Store().FindFreeSlots(day_start + 9 * 60, day_start + 17 * 60, 60))
+  {
+    std::cout << "Free slot: " << calendar_time::FormatTime(free_slot.first) << " - " << calendar_time::FormatTime(free_slot.second) << "\n";
+  }
+}
+
+/**
+ * Bulk mode: "--export <file> <count>" writes count generated entries, "--import <file>" reads an
+ * .ics file into a local calendar system. Both report their throughput in entries per second.
+ */
+int RunBulkMode(const std::string &mode, const std::string &path, std::size_t count)
+{
+  LocalCalendarSystem calendar_system;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::size_t entry_count = 0;
+  try
+  {
+    if (mode == "--export")
+    {
+      const std::int32_t first_minute = calendar_time::ParseDate("01.01.2000") * 1440;
+      const char *titles[] = {"Project meeting", "Lunch", "Design review", "Stand-up, daily"};
+      std::vector<CalendarEntryRecord> records;
+      for (std::size_t i = 0; i < count; i++)
+      {
+        records.push_back({first_minute + static_cast<std::int32_t>(i) * 30, 30 + static_cast<std::int32_t>(i % 4) * 15, TitleTable::Instance().Intern(titles[i % 4])});
+      }
+      calendar_system.Store().Add(records);
+      entry_count = ExportICalendar(calendar_system, path);
+    }
+    else
+    {
+      entry_count = ImportICalendar(path, calendar_system);
+    }
+  }
+  catch (const std::exception &error)
+  {
+    std::cerr << error.what() << "\n";
+    return 1;
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << (mode == "--export" ? "Exported " : "Imported ") << entry_count << " entries in " << elapsed.count() << " s ("
+            << entry_count / elapsed.count() << " entries/s)\n";
+  return 0;
+}
+
+/**
+ * iCalendar check: "--ics-check <path>" writes an .ics file to path whose events carry many
+ * distinct titles, short and long, folded across lines, imports it and checks every title and
+ * duration. It also checks that out-of-range dates and negative durations are rejected.
+ */
+int RunICalendarCheck(const std::string &path)
+{
+  const std::size_t event_count = 10000;
+  const std::int32_t first_minute = calendar_time::ParseDate("01.01.2000") * 1440;
+  auto expected_title = [](std::size_t event)
+  {
+    return (event % 2 == 0 ? "T" : "Long title of a meeting, folded across three lines of the file, number ") + std::to_string(event);
+  };
+  auto write_file = [&path](const std::string &content)
+  {
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    const bool written = file != nullptr && std::fwrite(content.data(), 1, content.size(), file) == content.size();
+    if (file == nullptr || std::fclose(file) != 0 || !written)
+    {
+      throw std::runtime_error("Cannot write " + path);
+    }
+  };
+
+  try
+  {
+    std::string content = "BEGIN:VCALENDAR\r\n";
+    for (std::size_t event = 0; event < event_count; event++)
+    {
+      // the title is split after its first character and again after 40 octets
+      const std::string title = expected_title(event);
+      content += "BEGIN:VEVENT\r\nDTSTART:20000101T000000Z\r\nDURATION:PT" + std::to_string(event % 600) + "M\r\n";
+      content += "SUMMARY:" + title.substr(0, 1) + "\r\n " + title.substr(1, 40) + (title.size() > 41 ? "\r\n " + title.substr(41) : "");
+      content += "\r\nDESCRIPTION:not a\r\n  title\r\nEND:VEVENT\r\n";
+    }
+    content += "END:VCALENDAR\r\n";
+    write_file(content);
+
+    LocalCalendarSystem calendar_system;
+    const std::size_t entry_count = ImportICalendar(path, calendar_system, 1000);
+    std::vector<bool> found(event_count, false);
+    std::size_t mismatch_count = 0;
+    calendar_system.Store().ForEach([&](const CalendarEntryRecord &record)
+                                    {
+      const std::string title = TitleTable::Instance().Title(record.title_id);
+      const std::size_t event = std::stoul(title.substr(title.rfind(' ') == std::string::npos ? 1 : title.rfind(' ') + 1));
+      if (event >= event_count || found[event] || title != expected_title(event) || record.start_minute != first_minute ||
+          record.duration_minutes != static_cast<std::int32_t>(event % 600))
+      {
+        mismatch_count++;
+        return;
+      }
+      found[event] = true; });
+    if (entry_count != event_count || mismatch_count != 0)
+    {
+      std::cerr << "Imported " << entry_count << " of " << event_count << " entries, " << mismatch_count << " wrong\n";
+      return 1;
+    }
+
+    const char *invalid_events[] = {"DTSTART:99991231T000000Z", "DTSTART:20240230T000000Z", "DTSTART:20240101T250000Z", "DURATION:-PT1H"};
+    for (const char *invalid_event : invalid_events)
+    {
+      write_file(std::string("BEGIN:VCALENDAR\r\nBEGIN:VEVENT\r\n") + invalid_event + "\r\nSUMMARY:x\r\nEND:VEVENT\r\nEND:VCALENDAR\r\n");
+      try
+      {
+        LocalCalendarSystem rejecting_calendar_system;
+        ImportICalendar(path, rejecting_calendar_system);
+        std::cerr << "Accepted " << invalid_event << "\n";
+        return 1;
+      }
+      catch (const std::invalid_argument &)
+      {
+      }
+    }
+  }
+  catch (const std::exception &error)
+  {
+    std::cerr << error.what() << "\n";
+    return 1;
+  }
+  std::cout << "Imported " << event_count << " entries with folded titles, invalid dates and durations rejected\n";
+  return 0;
+}
+
+/**
+ * Sync mode: "--sync" updates a set of entries repeatedly through the sync engine against mock
+ * backends of growing round-trip time, checks that the backend ends up with the latest version of
+ * every entry, and compares the throughput with sending every change on its own.
+ */
+int RunSyncMode()
 {
-  const CalendarEntry *calendar_entry = calendar_system.CreateCalendarEntry("Project meeting", "03.05.2024", "10:30 a.m.", "1 hour");
-  const ReminderItem *reminder_item = calendar_system.CreateReminderItem(*calendar_entry);
-  calendar_entry->ShowCalendarEntryInfo();
-  reminder_item->ShowReminderItemInfo();
+  const std::size_t entry_count = 20000;
+  const std::size_t update_count = 100000;
+  const std::int32_t first_minute = calendar_time::ParseDate("03.05.2024") * 1440;
+  const std::uint32_t title_id = TitleTable::Instance().Intern("Project meeting");
+  const long round_trips[] = {0, 100, 1000, 10000};
+  for (long round_trip : round_trips)
+  {
+    MockCalendarBackend backend{std::chrono::microseconds(round_trip)};
+    std::vector<CalendarEntryRecord> expected(entry_count);
+    SyncStatistics statistics;
+    std::chrono::duration<double> create_elapsed;
+    std::chrono::duration<double> update_elapsed;
+    {
+      CalendarSyncEngine sync_engine(backend);
+      // every entry once: nothing to coalesce, the throughput comes from batching and pipelining
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for (std::size_t entry = 0; entry < entry_count; entry++)
+      {
+        expected[entry] = {first_minute + static_cast<std::int32_t>(entry), 60, title_id};
+        sync_engine.Upsert(entry, expected[entry]);
+      }
+      sync_engine.Flush();
+      create_elapsed = std::chrono::steady_clock::now() - start;
+
+      // repeated updates of the same entries
+      start = std::chrono::steady_clock::now();
+      for (std::size_t i = 0; i < update_count; i++)
+      {
+        std::size_t entry = (i * 7919) % entry_count;
+        expected[entry].start_minute = first_minute + static_cast<std::int32_t>(i);
+        sync_engine.Upsert(entry, expected[entry]);
+      }
+      sync_engine.Flush();
+      update_elapsed = std::chrono::steady_clock::now() - start;
+      statistics = sync_engine.Statistics();
+    }
+
+    bool consistent = backend.size() == entry_count;
+    for (std::size_t entry = 0; entry < entry_count && consistent; entry++)
+    {
+      CalendarEntryRecord record = {0, 0, 0};
+      consistent = backend.Find(entry, record) && record.start_minute == expected[entry].start_minute;
+    }
+
+    // one request per change, waiting for each acknowledgement
+    const std::size_t unbatched_count = round_trip == 0 ? 1000 : 100;
+    std::chrono::steady_clock::time_point unbatched_start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < unbatched_count; i++)
+    {
+      std::mutex done_mutex;
+      std::condition_variable done_changed;
+      bool done = false;
+      backend.Send({{SyncOperation::UPSERT, i, expected[i]}}, [&]
+                   {
+                     std::lock_guard<std::mutex> lock(done_mutex);
+                     done = true;
+                     done_changed.notify_one(); });
+      std::unique_lock<std::mutex> lock(done_mutex);
+      done_changed.wait(lock, [&]
+                        { return done; });
+    }
+    std::chrono::duration<double> unbatched_elapsed = std::chrono::steady_clock::now() - unbatched_start;
+
+    std::cout << "Round trip " << round_trip << " us: " << entry_count / create_elapsed.count() << " creates/s, "
+              << update_count / update_elapsed.count() << " updates/s batched (" << statistics.coalesced << " coalesced, "
+              << statistics.batches << " batches), "
+              << unbatched_count / unbatched_elapsed.count() << " updates/s unbatched, backend "
+              << (consistent ? "consistent" : "INCONSISTENT") << "\n";
+    if (!consistent)
+    {
+      return 1;
+    }
+  }
+  return 0;
 }
 
-int main()
+/**
+ * Reminder benchmark: "--reminders [count]" creates count reminders (1M by default) through the
+ * calendar system, schedules them over the next two seconds, cancels every fourth and measures
+ * the cost of scheduling and cancelling and how late the remaining ones fire.
+ */
+int RunReminderBenchmark(std::size_t reminder_count)
 {
+  LocalCalendarSystem calendar_system;
+  std::unique_ptr<CalendarEntry> calendar_entry(calendar_system.CreateCalendarEntry("Project meeting", "03.05.2024", "10:30 a.m.", "1 hour"));
+  std::vector<std::unique_ptr<ReminderItem>> reminders;
+  reminders.reserve(reminder_count);
+  for (std::size_t i = 0; i < reminder_count; i++)
+  {
+    reminders.emplace_back(calendar_system.CreateReminderItem(*calendar_entry));
+  }
+
+  // lateness histogram in buckets of powers of two microseconds, written by the dispatch thread only
+  std::vector<std::size_t> lateness_histogram(32, 0);
+  std::atomic<std::size_t> fired_count(0);
+  std::int64_t max_lateness = 0;
+  ReminderScheduler scheduler([&](const ReminderItem &, std::chrono::steady_clock::duration lateness)
+                              {
+                                std::int64_t microseconds = std::max<std::int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(lateness).count());
+                                max_lateness = std::max(max_lateness, microseconds);
+                                int bucket = 0;
+                                while (bucket < 31 && (std::int64_t(1) << bucket) <= microseconds)
+                                {
+                                  bucket++;
+                                }
+                                lateness_histogram[bucket]++;
+                                fired_count.fetch_add(1, std::memory_order_release); });
+
+  std::chrono::steady_clock::time_point first_due = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+  std::vector<ReminderScheduler::Handle> handles(reminder_count);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < reminder_count; i++)
+  {
+    handles[i] = scheduler.Schedule(*reminders[i], first_due + std::chrono::microseconds((i * 7919) % 2000000));
+  }
+  std::chrono::duration<double, std::nano> schedule_elapsed = std::chrono::steady_clock::now() - start;
+  std::size_t pending_count = scheduler.PendingCount();
+
+  std::size_t cancelled_count = 0;
+  start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < reminder_count; i += 4)
+  {
+    cancelled_count += scheduler.Cancel(handles[i]);
+  }
+  std::chrono::duration<double, std::nano> cancel_elapsed = std::chrono::steady_clock::now() - start;
+
+  while (fired_count.load(std::memory_order_acquire) < reminder_count - cancelled_count)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::size_t median_bucket = 0, p99_bucket = 0, seen = 0;
+  for (std::size_t bucket = 0; bucket < lateness_histogram.size(); bucket++)
+  {
+    seen += lateness_histogram[bucket];
+    median_bucket = seen * 2 < fired_count ? bucket + 1 : median_bucket;
+    p99_bucket = seen * 100 < fired_count * 99 ? bucket + 1 : p99_bucket;
+  }
+  std::cout << "Scheduled " << reminder_count << " reminders (" << pending_count << " pending): "
+            << schedule_elapsed.count() / reminder_count << " ns per schedule, "
+            << cancel_elapsed.count() / std::max<std::size_t>(1, (reminder_count + 3) / 4) << " ns per cancel\n";
+  std::cout << "Fired " << fired_count << " reminders, lateness median < " << (1u << median_bucket) << " us, 99% < "
+            << (1u << p99_bucket) << " us, max " << max_lateness << " us\n";
+  return 0;
+}
+
+/**
+ * Event benchmark: "--events [count]" creates and destroys count entries with their reminders,
+ * once as two heap objects from the factory and once as one calendar event from the arena, from
+ * text and from an already parsed record. Every case runs a tenth of the count untimed first, so
+ * the case measured first does not pay for warming up the caches, the heap and the title table.
+ */
+int RunEventBenchmark(std::size_t event_count)
+{
+  LocalCalendarSystem calendar_system;
+  const std::string title = "Project meeting", date = "03.05.2024", time_start = "10:30 a.m.", duration = "1 hour";
+  const CalendarEntryRecord record = CalendarEntry::ParseRecord(title, date, time_start, duration);
+  std::int64_t checksum = 0;
+
+  auto create_separately = [&](std::size_t count)
+  {
+    for (std::size_t i = 0; i < count; i++)
+    {
+      std::unique_ptr<CalendarEntry> calendar_entry(calendar_system.CreateCalendarEntry(title, date, time_start, duration));
+      std::unique_ptr<ReminderItem> reminder_item(calendar_system.CreateReminderItem(*calendar_entry));
+      checksum += reminder_item->start_minute - record.start_minute;
+    }
+  };
+  auto create_from_text = [&](std::size_t count)
+  {
+    for (std::size_t i = 0; i < count; i++)
+    {
+      CalendarEventPtr calendar_event = calendar_system.CreateCalendarEvent(title, date, time_start, duration);
+      checksum += calendar_event->Reminder().start_minute - record.start_minute;
+    }
+  };
+  // without parsing the text, what remains is the allocation and construction
+  auto create_from_record = [&](std::size_t count)
+  {
+    for (std::size_t i = 0; i < count; i++)
+    {
+      CalendarEventPtr calendar_event = calendar_system.CreateCalendarEvent(record);
+      checksum += calendar_event->Reminder().start_minute - record.start_minute;
+    }
+  };
+  auto measure = [event_count](auto create)
+  {
+    create(event_count / 10);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    create(event_count);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / event_count;
+  };
+
+  const double separate_ns = measure(create_separately);
+  const double text_ns = measure(create_from_text);
+  const double record_ns = measure(create_from_record);
+  std::cout << "Entry and reminder: " << separate_ns << " ns separately, " << text_ns << " ns as calendar event, "
+            << record_ns << " ns as calendar event from a parsed record (checksum " << checksum << ")\n";
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc > 1 && std::string(argv[1]) == "--events")
+  {
+    return RunEventBenchmark(argc > 2 ? std::stoul(argv[2]) : 1000000);
+  }
+  if (argc > 1 && std::string(argv[1]) == "--reminders")
+  {
+    return RunReminderBenchmark(argc > 2 ? std::stoul(argv[2]) : 1000000);
+  }
+  if (argc > 1 && std::string(argv[1]) == "--sync")
+  {
+    return RunSyncMode();
+  }
+  if (argc > 2 && std::string(argv[1]) == "--ics-check")
+  {
+    return RunICalendarCheck(argv[2]);
+  }
+  if (argc > 2 && (std::string(argv[1]) == "--import" || std::string(argv[1]) == "--export"))
+  {
+    return RunBulkMode(argv[1], argv[2], argc > 3 ? std::stoul(argv[3]) : 0);
+  }
+
   std::cout << "Client: Using Google calendar system:\n";
   GoogleCalendarSystem *client_calendar_1 = new GoogleCalendarSystem();
   ClientCode(*client_calendar_1);
@@ -1,5 +1,11 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <new>
 #include <string>
+#include <vector>
 
 /**
  * Abstract Factory Design Pattern
@@ -23,12 +29,17 @@ class AbstractProductA {
  */
 class ConcreteProductA1 : public AbstractProductA {
  public:
+  static constexpr bool kStateless = true;
   std::string UsefulFunctionA() const override {
     return "The result of the product A1.";
   }
 };
 
 class ConcreteProductA2 : public AbstractProductA {
+ public:
+  static constexpr bool kStateless = true;
+
+ private:
   std::string UsefulFunctionA() const override {
     return "The result of the product A2.";
   }
@@ -60,6 +71,7 @@ class AbstractProductB {
  */
 class ConcreteProductB1 : public AbstractProductB {
  public:
+  static constexpr bool kStateless = true;
   std::string UsefulFunctionB() const override {
     return "The result of the product B1.";
   }
@@ -74,8 +86,17 @@ class ConcreteProductB1 : public AbstractProductB {
   }
 };
 
+/**
+ * Product B2 counts its collaborations, so it has state of its own: it cannot be
+ * shared between clients, and the kCached policy gives every client its own
+ * instance from a free list.
+ */
 class ConcreteProductB2 : public AbstractProductB {
+ private:
+  mutable std::size_t collaboration_count_ = 0;
+
  public:
+  static constexpr bool kStateless = false;
   std::string UsefulFunctionB() const override {
     return "The result of the product B2.";
   }
@@ -85,11 +106,109 @@ class ConcreteProductB2 : public AbstractProductB {
    * argument.
    */
   std::string AnotherUsefulFunctionB(const AbstractProductA &collaborator) const override {
+    collaboration_count_++;
     const std::string result = collaborator.UsefulFunctionA();
     return "The result of the B2 collaborating with ( " + result + " )";
   }
+  std::size_t CollaborationCount() const {
+    return collaboration_count_;
+  }
+};
+
+/**
+ * Products handed out by a factory are owned through a handle, whose deleter gives the product
+ * back to where it came from: the heap, a free list, or nowhere for a shared instance that lives
+ * as long as the program. The factories hand out handles to const products, so a shared instance
+ * cannot be changed by one client under the feet of the others.
+ */
+template <typename Product>
+class ProductRecycler {
+ public:
+  virtual ~ProductRecycler(){};
+  virtual void Recycle(Product *product) = 0;
+};
+
+template <typename Product>
+struct ProductDeleter {
+  ProductRecycler<Product> *recycler;  // nullptr for shared instances
+
+  void operator()(Product *product) const {
+    if (recycler != nullptr) {
+      recycler->Recycle(product);
+    }
+  }
 };
 
+template <typename Product>
+using ProductHandle = std::unique_ptr<Product, ProductDeleter<Product>>;
+
+template <typename Product>
+class HeapRecycler : public ProductRecycler<Product> {
+ public:
+  static HeapRecycler &Instance() {
+    static HeapRecycler heap_recycler;
+    return heap_recycler;
+  }
+  void Recycle(Product *product) override {
+    delete product;
+  }
+};
+
+/**
+ * Free list of one concrete product. Memory is taken from slabs and reused once a product is
+ * recycled. The free list is not thread-safe, and must outlive all handles it gave out. The
+ * factories use the free list of the calling thread (ThreadFreeList), so const factories shared
+ * between threads need no lock; a pooled product has to be released on the thread that acquired
+ * it, before that thread exits.
+ */
+template <typename ConcreteProduct, typename Product>
+class ProductFreeList : public ProductRecycler<Product> {
+ private:
+  union Slot {
+    Slot *next;
+    alignas(ConcreteProduct) unsigned char storage[sizeof(ConcreteProduct)];
+  };
+
+  std::vector<std::unique_ptr<Slot[]>> slabs_;
+  Slot *free_slots_ = nullptr;
+  static constexpr std::size_t kSlabSize = 64;
+
+ public:
+  static ProductFreeList &ThreadFreeList() {
+    thread_local ProductFreeList free_list;
+    return free_list;
+  }
+
+  ProductHandle<Product> Acquire() {
+    if (free_slots_ == nullptr) {
+      slabs_.emplace_back(new Slot[kSlabSize]);
+      for (std::size_t i = 0; i < kSlabSize; i++) {
+        slabs_.back()[i].next = free_slots_;
+        free_slots_ = &slabs_.back()[i];
+      }
+    }
+    Slot *slot = free_slots_;
+    free_slots_ = slot->next;
+    return ProductHandle<Product>(new (slot->storage) ConcreteProduct(), ProductDeleter<Product>{this});
+  }
+
+  void Recycle(Product *product) override {
+    ConcreteProduct *concrete_product = const_cast<ConcreteProduct *>(static_cast<const ConcreteProduct *>(product));
+    concrete_product->~ConcreteProduct();
+    Slot *slot = reinterpret_cast<Slot *>(concrete_product);
+    slot->next = free_slots_;
+    free_slots_ = slot;
+  }
+};
+
+/**
+ * How a factory provides its products:
+ * - kAllocate: a new product from the heap for every call,
+ * - kPooled: products from free lists, one per product of the family and thread,
+ * - kCached: one shared instance for every stateless product, free lists for the others.
+ */
+enum class ProductPolicy { kAllocate, kPooled, kCached };
+
 /**
  * The Abstract Factory interface declares a set of methods that return
  * different abstract products. These products are called a family and are
@@ -100,8 +219,49 @@ class ConcreteProductB2 : public AbstractProductB {
  */
 class AbstractFactory {
  public:
+  virtual ~AbstractFactory(){};
   virtual AbstractProductA *CreateProductA() const = 0;
   virtual AbstractProductB *CreateProductB() const = 0;
+  virtual ProductHandle<const AbstractProductA> AcquireProductA() const = 0;
+  virtual ProductHandle<const AbstractProductB> AcquireProductB() const = 0;
+};
+
+/**
+ * Implements the acquiring of products for a family according to the product policy of the
+ * factory. Stateless products are marked by kStateless.
+ */
+template <typename ConcreteProductA, typename ConcreteProductB>
+class ProductFamilyFactory : public AbstractFactory {
+ public:
+  explicit ProductFamilyFactory(ProductPolicy policy) : policy_(policy) {}
+
+  ProductHandle<const AbstractProductA> AcquireProductA() const override {
+    return this->Acquire<ConcreteProductA, const AbstractProductA>();
+  }
+  ProductHandle<const AbstractProductB> AcquireProductB() const override {
+    return this->Acquire<ConcreteProductB, const AbstractProductB>();
+  }
+
+ private:
+  ProductPolicy policy_;
+
+  // shared instances are never destroyed, so they stay valid during static destruction
+  template <typename ConcreteProduct>
+  static const ConcreteProduct &SharedInstance() {
+    static const ConcreteProduct *shared_instance = new ConcreteProduct();
+    return *shared_instance;
+  }
+
+  template <typename ConcreteProduct, typename Product>
+  ProductHandle<Product> Acquire() const {
+    if (policy_ == ProductPolicy::kCached && ConcreteProduct::kStateless) {
+      return ProductHandle<Product>(&SharedInstance<ConcreteProduct>(), ProductDeleter<Product>{nullptr});
+    }
+    if (policy_ == ProductPolicy::kAllocate) {
+      return ProductHandle<Product>(new ConcreteProduct(), ProductDeleter<Product>{&HeapRecycler<Product>::Instance()});
+    }
+    return ProductFreeList<ConcreteProduct, Product>::ThreadFreeList().Acquire();
+  }
 };
 
 /**
@@ -110,8 +270,9 @@ class AbstractFactory {
  * that signatures of the Concrete Factory's methods return an abstract product,
  * while inside the method a concrete product is instantiated.
  */
-class ConcreteFactory1 : public AbstractFactory {
+class ConcreteFactory1 : public ProductFamilyFactory<ConcreteProductA1, ConcreteProductB1> {
  public:
+  explicit ConcreteFactory1(ProductPolicy policy = ProductPolicy::kAllocate) : ProductFamilyFactory(policy) {}
   AbstractProductA *CreateProductA() const override {
     return new ConcreteProductA1();
   }
@@ -123,8 +284,9 @@ class ConcreteFactory1 : public AbstractFactory {
 /**
  * Each Concrete Factory has a corresponding product variant.
  */
-class ConcreteFactory2 : public AbstractFactory {
+class ConcreteFactory2 : public ProductFamilyFactory<ConcreteProductA2, ConcreteProductB2> {
  public:
+  explicit ConcreteFactory2(ProductPolicy policy = ProductPolicy::kAllocate) : ProductFamilyFactory(policy) {}
   AbstractProductA *CreateProductA() const override {
     return new ConcreteProductA2();
   }
@@ -140,23 +302,100 @@ class ConcreteFactory2 : public AbstractFactory {
  */
 
 void ClientCode(const AbstractFactory &factory) {
-  const AbstractProductA *product_a = factory.CreateProductA();
-  const AbstractProductB *product_b = factory.CreateProductB();
+  ProductHandle<const AbstractProductA> product_a = factory.AcquireProductA();
+  ProductHandle<const AbstractProductB> product_b = factory.AcquireProductB();
   std::cout << product_b->UsefulFunctionB() << "\n";
   std::cout << product_b->AnotherUsefulFunctionB(*product_a) << "\n";
-  delete product_a;
-  delete product_b;
 }
 
-int main() {
+/**
+ * Benchmark, started with "--benchmark": runs millions of create-collaborate-destroy cycles
+ * with every product policy, and prints time and heap allocations per cycle as one JSON line
+ * per case.
+ */
+std::atomic<std::size_t> allocation_count(0);
+
+// the replaced operator new and delete below pair malloc with free, which GCC cannot see through
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void *pointer = std::malloc(size == 0 ? 1 : size)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+// the result of every cycle is stored here, so the cycles are not optimized away
+volatile std::size_t benchmark_sink = 0;
+
+template <typename Cycle>
+void RunBenchmarkCase(const std::string &factory, const std::string &policy, std::size_t cycle_count, Cycle cycle) {
+  std::size_t allocations_before = allocation_count.load();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < cycle_count; i++) {
+    benchmark_sink = cycle();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::size_t allocations = allocation_count.load() - allocations_before;
+
+  std::cout << "{\"benchmark\": \"abstract_factory\""
+            << ", \"factory\": \"" << factory << "\""
+            << ", \"policy\": \"" << policy << "\""
+            << ", \"cycles\": " << cycle_count
+            << ", \"ns_per_cycle\": " << elapsed.count() * 1e9 / cycle_count
+            << ", \"allocations_per_cycle\": " << static_cast<double>(allocations) / cycle_count
+            << "}" << std::endl;
+}
+
+template <typename ConcreteFactory>
+void BenchmarkFactory(const std::string &name, std::size_t cycle_count) {
+  const ConcreteFactory factory;
+  RunBenchmarkCase(name, "CreateAndDelete", cycle_count, [&]() {
+    const AbstractProductA *product_a = factory.CreateProductA();
+    const AbstractProductB *product_b = factory.CreateProductB();
+    std::size_t result_length = product_b->AnotherUsefulFunctionB(*product_a).size();
+    delete product_a;
+    delete product_b;
+    return result_length;
+  });
+  const std::pair<ProductPolicy, const char *> policies[] = {
+      {ProductPolicy::kAllocate, "Allocate"}, {ProductPolicy::kPooled, "Pooled"}, {ProductPolicy::kCached, "Cached"}};
+  for (const std::pair<ProductPolicy, const char *> &policy : policies) {
+    const ConcreteFactory policy_factory(policy.first);
+    RunBenchmarkCase(name, policy.second, cycle_count, [&]() {
+      ProductHandle<const AbstractProductA> product_a = policy_factory.AcquireProductA();
+      ProductHandle<const AbstractProductB> product_b = policy_factory.AcquireProductB();
+      return product_b->AnotherUsefulFunctionB(*product_a).size();
+    });
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+    const std::size_t cycle_count = 5000000;
+    BenchmarkFactory<ConcreteFactory1>("ConcreteFactory1", cycle_count);
+    BenchmarkFactory<ConcreteFactory2>("ConcreteFactory2", cycle_count);
+    return 0;
+  }
   std::cout << "Client: Testing client code with the first factory type:\n";
-  ConcreteFactory1 *f1 = new ConcreteFactory1();
+  ConcreteFactory1 *f1 = new ConcreteFactory1(ProductPolicy::kCached);
   ClientCode(*f1);
   delete f1;
   std::cout << std::endl;
   std::cout << "Client: Testing the same client code with the second factory type:\n";
-  ConcreteFactory2 *f2 = new ConcreteFactory2();
+  ConcreteFactory2 *f2 = new ConcreteFactory2(ProductPolicy::kCached);
   ClientCode(*f2);
   delete f2;
   return 0;
-}
\ No newline at end of file
+}
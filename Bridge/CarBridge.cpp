@@ -1,5 +1,64 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Sensor frame delivered to the driver assistance system once per cycle: the detections of the
+ * radars and the lane seen by the front camera. The frame is a plain record of fixed size, so it
+ * can be copied through lock-free queues and stored in recordings.
+*/
+struct RadarTarget {
+    float range_m;
+    float range_rate_mps;   // negative while the target comes closer
+    float azimuth_rad;      // positive to the left
+};
+
+struct SensorFrame {
+    static constexpr std::size_t kMaxRadarTargets = 16;
+
+    std::uint64_t sequence;
+    std::chrono::steady_clock::time_point captured;
+    float ego_speed_mps;
+    std::uint32_t radar_target_count;
+    RadarTarget radar_targets[kMaxRadarTargets];
+    float lane_offset_m;          // camera: offset of the vehicle from the lane center, positive to the left
+    float lane_heading_rad;       // camera: heading of the vehicle relative to the lane
+    float lane_curvature_per_m;   // camera: curvature of the lane ahead
+};
+
+// result of processing one frame: acceleration demand and steering angle
+struct ControlCommand {
+    float acceleration_mps2 = 0.0f;
+    float steering_angle_rad = 0.0f;
+};
+
+// nearest radar target inside the own lane, or nullptr
+inline const RadarTarget* FindLeadVehicle(const SensorFrame& frame) {
+    const RadarTarget* lead_vehicle = nullptr;
+    for (std::uint32_t i = 0; i < frame.radar_target_count; i++) {
+        const RadarTarget& target = frame.radar_targets[i];
+        float lateral_distance = target.range_m * std::sin(target.azimuth_rad) - frame.lane_offset_m;
+        if (std::fabs(lateral_distance) < 1.8f && (lead_vehicle == nullptr || target.range_m < lead_vehicle->range_m)) {
+            lead_vehicle = &target;
+        }
+    }
+    return lead_vehicle;
+}
+
+inline float Clamp(float value, float low, float high) {
+    return value < low ? low : (value > high ? high : value);
+}
 
 /**
  * The DriverAssistanceSystem defines the interface for classes for the implementation
@@ -10,6 +69,10 @@ class DriverAssistanceSystem {
     virtual ~DriverAssistanceSystem() {}
     virtual std::string LongitudinalControlSubsystem() const = 0;
     virtual std::string LateralControlSubsystem() const = 0;
+    // acceleration demand from the sensor frame
+    virtual float ProcessLongitudinal(const SensorFrame& frame) const = 0;
+    // steering angle from the sensor frame
+    virtual float ProcessLateral(const SensorFrame& frame) const = 0;
 };
 
 /**
@@ -24,6 +87,19 @@ class DriverAssistanceSystemSupplierA : public DriverAssistanceSystem {
     std::string LateralControlSubsystem() const override {
         return "Driver assistance system of supplier A: 3x rear radars + 4 side radars.\n";
     }
+    // time gap control behind the lead vehicle, speed control without one
+    float ProcessLongitudinal(const SensorFrame& frame) const override {
+        const RadarTarget* lead_vehicle = FindLeadVehicle(frame);
+        if (lead_vehicle == nullptr) {
+            return Clamp(0.3f * (33.3f - frame.ego_speed_mps), -2.0f, 1.5f);
+        }
+        float desired_gap = 5.0f + 1.8f * frame.ego_speed_mps;
+        return Clamp(0.2f * (lead_vehicle->range_m - desired_gap) + 0.6f * lead_vehicle->range_rate_mps, -5.0f, 1.5f);
+    }
+    // lane centering from the camera: feed forward of the curvature, feedback of offset and heading
+    float ProcessLateral(const SensorFrame& frame) const override {
+        return std::atan(2.8f * frame.lane_curvature_per_m) - 0.08f * frame.lane_offset_m - 0.6f * frame.lane_heading_rad;
+    }
 };
 
 /**
@@ -38,6 +114,21 @@ class DriverAssistanceSystemSupplierB : public DriverAssistanceSystem {
     std::string LateralControlSubsystem() const override {
         return "Driver assistance system of supplier B: 2x rear radars + 2 side radars.\n";
     }
+    // time gap control like supplier A, with emergency braking below 2 s time to collision
+    float ProcessLongitudinal(const SensorFrame& frame) const override {
+        const RadarTarget* lead_vehicle = FindLeadVehicle(frame);
+        if (lead_vehicle == nullptr) {
+            return Clamp(0.25f * (33.3f - frame.ego_speed_mps), -2.0f, 1.2f);
+        }
+        if (lead_vehicle->range_rate_mps < 0.0f && lead_vehicle->range_m < -2.0f * lead_vehicle->range_rate_mps) {
+            return -8.0f;
+        }
+        float desired_gap = 6.0f + 2.0f * frame.ego_speed_mps;
+        return Clamp(0.15f * (lead_vehicle->range_m - desired_gap) + 0.5f * lead_vehicle->range_rate_mps, -5.0f, 1.2f);
+    }
+    float ProcessLateral(const SensorFrame& frame) const override {
+        return std::atan(2.8f * frame.lane_curvature_per_m) - 0.05f * frame.lane_offset_m - 0.5f * frame.lane_heading_rad;
+    }
 };
 
 /**
@@ -46,7 +137,18 @@ class DriverAssistanceSystemSupplierB : public DriverAssistanceSystem {
 */
 class DriverAssistanceFeature {
   protected:
-    DriverAssistanceSystem* driver_assistance_system_;
+    // the driver assistance system the feature currently runs on; extended features reach it only
+    // through here, so SetDriverAssistanceSystem stays the one place where it can change
+    const DriverAssistanceSystem& CurrentDriverAssistanceSystem() const {
+        return *this->driver_assistance_system_;
+    }
+
+    // composes the operation from the subsystems of the current driver assistance system
+    virtual std::string ComposeAssistanceOperation() const {
+        return "Driver assistance feature is realized with: \n" +
+               this->CurrentDriverAssistanceSystem().LongitudinalControlSubsystem() +
+               this->CurrentDriverAssistanceSystem().LateralControlSubsystem();
+    }
 
   public:
     DriverAssistanceFeature(DriverAssistanceSystem* driver_assistance_system) : driver_assistance_system_(driver_assistance_system) {
@@ -55,11 +157,43 @@ class DriverAssistanceFeature {
     virtual ~DriverAssistanceFeature() {
     }
 
-    virtual std::string AssistanceOperation() const {
-        return "Driver assistance feature is realized with: \n" +
-               this->driver_assistance_system_->LongitudinalControlSubsystem() +
-               this->driver_assistance_system_->LateralControlSubsystem();
+    virtual ControlCommand ProcessFrame(const SensorFrame& frame) const {
+        ControlCommand control_command;
+        control_command.acceleration_mps2 = this->CurrentDriverAssistanceSystem().ProcessLongitudinal(frame);
+        control_command.steering_angle_rad = this->CurrentDriverAssistanceSystem().ProcessLateral(frame);
+        return control_command;
+    }
+
+    // ProcessFrame and AssistanceOperation may be called from several threads at once, but
+    // SetDriverAssistanceSystem must not run while any other thread uses the feature
+    void SetDriverAssistanceSystem(DriverAssistanceSystem* driver_assistance_system) {
+        this->driver_assistance_system_ = driver_assistance_system;
+        this->bound_operation_.store(nullptr, std::memory_order_relaxed);
+    }
+
+    // the operation is composed on the first call after construction or a rebind; later calls are
+    // one atomic load and allocate nothing. The returned text stays valid as long as the feature:
+    // after SetDriverAssistanceSystem it still describes the system it was composed for.
+    const std::string& AssistanceOperation() const {
+        const std::string* bound_operation = this->bound_operation_.load(std::memory_order_acquire);
+        if (bound_operation == nullptr) {
+            std::lock_guard<std::mutex> lock(this->composed_operations_mutex_);
+            bound_operation = this->bound_operation_.load(std::memory_order_relaxed);
+            if (bound_operation == nullptr) {
+                this->composed_operations_.emplace_back(new std::string(this->ComposeAssistanceOperation()));
+                bound_operation = this->composed_operations_.back().get();
+                this->bound_operation_.store(bound_operation, std::memory_order_release);
+            }
+        }
+        return *bound_operation;
     }
+
+  private:
+    DriverAssistanceSystem* driver_assistance_system_;
+    mutable std::atomic<const std::string*> bound_operation_{nullptr};
+    // every operation composed so far, kept so that references handed out stay valid
+    mutable std::mutex composed_operations_mutex_;
+    mutable std::vector<std::unique_ptr<const std::string>> composed_operations_;
 };
 
 /**
@@ -72,10 +206,11 @@ class ExtendedDriverAssistanceFeature : public DriverAssistanceFeature {
     ExtendedDriverAssistanceFeature(DriverAssistanceSystem* driver_assistance_system) : DriverAssistanceFeature(driver_assistance_system) {
     }
 
-    std::string AssistanceOperation() const override {
+  protected:
+    std::string ComposeAssistanceOperation() const override {
         return "Extended driver assistance feature is realized with: \n" +
-               this->driver_assistance_system_->LongitudinalControlSubsystem() +
-               this->driver_assistance_system_->LateralControlSubsystem() +
+               this->CurrentDriverAssistanceSystem().LongitudinalControlSubsystem() +
+               this->CurrentDriverAssistanceSystem().LateralControlSubsystem() +
                "with higher accuracy on all radars and camaras.\n";
     }
 };
@@ -90,13 +225,479 @@ class HighwayDriverAssistanceFeature : public DriverAssistanceFeature {
     HighwayDriverAssistanceFeature(DriverAssistanceSystem* driver_assistance_system) : DriverAssistanceFeature(driver_assistance_system) {
     }
 
-    std::string AssistanceOperation() const override {
+  protected:
+    std::string ComposeAssistanceOperation() const override {
         return "Highway driver assistance feature is realized with: \n" +
-               this->driver_assistance_system_->LongitudinalControlSubsystem() +
+               this->CurrentDriverAssistanceSystem().LongitudinalControlSubsystem() +
                "Lateral control disabled.\n.";
     }
+
+  public:
+    ControlCommand ProcessFrame(const SensorFrame& frame) const override {
+        ControlCommand control_command;
+        control_command.acceleration_mps2 = this->CurrentDriverAssistanceSystem().ProcessLongitudinal(frame);
+        return control_command;
+    }
+};
+
+/**
+ * Static form of the features, for configurations known at compile time: the feature is a
+ * template on the concrete driver assistance system and holds it by value, so the calls into
+ * the system are resolved at compile time and can be inlined, as in
+ * StaticHighwayDriverAssistanceFeature<DriverAssistanceSystemSupplierA>. The features derive from
+ * the CRTP base StaticFeature, which calls the ComposeAssistanceOperation and ComputeControl of the
+ * concrete feature, so a call through the base runs the logic of the concrete feature as well.
+ * Each feature composes its operation text once, when it is constructed.
+*/
+template <typename ConcreteFeature, typename ConcreteDriverAssistanceSystem>
+class StaticFeature {
+  protected:
+    ConcreteDriverAssistanceSystem driver_assistance_system_;
+    std::string bound_operation_;
+
+  public:
+    StaticFeature() : bound_operation_(ConcreteFeature::ComposeAssistanceOperation(this->driver_assistance_system_)) {
+    }
+
+    const std::string& AssistanceOperation() const {
+        return this->bound_operation_;
+    }
+
+    ControlCommand ProcessFrame(const SensorFrame& frame) const {
+        return ConcreteFeature::ComputeControl(this->driver_assistance_system_, frame);
+    }
+
+    // longitudinal and lateral control; a feature that controls differently hides it. The calls are
+    // qualified with the concrete system, so they bind statically through the reference.
+    static ControlCommand ComputeControl(const ConcreteDriverAssistanceSystem& driver_assistance_system, const SensorFrame& frame) {
+        ControlCommand control_command;
+        control_command.acceleration_mps2 = driver_assistance_system.ConcreteDriverAssistanceSystem::ProcessLongitudinal(frame);
+        control_command.steering_angle_rad = driver_assistance_system.ConcreteDriverAssistanceSystem::ProcessLateral(frame);
+        return control_command;
+    }
+};
+
+template <typename ConcreteDriverAssistanceSystem>
+class StaticDriverAssistanceFeature
+    : public StaticFeature<StaticDriverAssistanceFeature<ConcreteDriverAssistanceSystem>, ConcreteDriverAssistanceSystem> {
+  public:
+    static std::string ComposeAssistanceOperation(const ConcreteDriverAssistanceSystem& driver_assistance_system) {
+        return "Driver assistance feature is realized with: \n" +
+               driver_assistance_system.LongitudinalControlSubsystem() +
+               driver_assistance_system.LateralControlSubsystem();
+    }
+};
+
+template <typename ConcreteDriverAssistanceSystem>
+class StaticExtendedDriverAssistanceFeature
+    : public StaticFeature<StaticExtendedDriverAssistanceFeature<ConcreteDriverAssistanceSystem>, ConcreteDriverAssistanceSystem> {
+  public:
+    static std::string ComposeAssistanceOperation(const ConcreteDriverAssistanceSystem& driver_assistance_system) {
+        return "Extended driver assistance feature is realized with: \n" +
+               driver_assistance_system.LongitudinalControlSubsystem() +
+               driver_assistance_system.LateralControlSubsystem() +
+               "with higher accuracy on all radars and camaras.\n";
+    }
+};
+
+template <typename ConcreteDriverAssistanceSystem>
+class StaticHighwayDriverAssistanceFeature
+    : public StaticFeature<StaticHighwayDriverAssistanceFeature<ConcreteDriverAssistanceSystem>, ConcreteDriverAssistanceSystem> {
+  public:
+    static std::string ComposeAssistanceOperation(const ConcreteDriverAssistanceSystem& driver_assistance_system) {
+        return "Highway driver assistance feature is realized with: \n" +
+               driver_assistance_system.LongitudinalControlSubsystem() +
+               "Lateral control disabled.\n.";
+    }
+
+    static ControlCommand ComputeControl(const ConcreteDriverAssistanceSystem& driver_assistance_system, const SensorFrame& frame) {
+        ControlCommand control_command;
+        control_command.acceleration_mps2 = driver_assistance_system.ConcreteDriverAssistanceSystem::ProcessLongitudinal(frame);
+        return control_command;
+    }
+};
+
+/**
+ * The SensorFrameGenerator simulates the sensors of a vehicle following a lead vehicle on a
+ * winding highway lane, with clutter targets around it.
+*/
+class SensorFrameGenerator {
+  public:
+    explicit SensorFrameGenerator(std::uint32_t seed = 1) : random_(seed) {
+    }
+
+    SensorFrame Next(float cycle_seconds) {
+        time_ += cycle_seconds;
+        float lead_speed = 30.0f + 4.0f * std::sin(0.2f * time_);
+        lead_range_ += (lead_speed - ego_speed_) * cycle_seconds;
+        ego_speed_ += Clamp(0.2f * (lead_range_ - 60.0f), -3.0f, 1.5f) * cycle_seconds;
+
+        SensorFrame frame = {};
+        frame.sequence = sequence_++;
+        frame.ego_speed_mps = ego_speed_;
+        frame.lane_offset_m = 0.3f * std::sin(0.5f * time_) + noise_(random_) * 0.02f;
+        frame.lane_heading_rad = 0.01f * std::cos(0.5f * time_) + noise_(random_) * 0.001f;
+        frame.lane_curvature_per_m = 0.002f * std::sin(0.05f * time_);
+        frame.radar_targets[0] = {lead_range_ + noise_(random_) * 0.2f, lead_speed - ego_speed_, noise_(random_) * 0.005f};
+        std::uniform_int_distribution<std::uint32_t> clutter_count(3, SensorFrame::kMaxRadarTargets - 1);
+        std::uniform_real_distribution<float> clutter_range(5.0f, 150.0f);
+        std::uniform_real_distribution<float> clutter_azimuth(-0.8f, 0.8f);
+        frame.radar_target_count = 1 + clutter_count(random_);
+        for (std::uint32_t i = 1; i < frame.radar_target_count; i++) {
+            float range = clutter_range(random_);
+            float azimuth = clutter_azimuth(random_);
+            if (std::fabs(range * std::sin(azimuth)) < 2.0f) {
+                azimuth = azimuth < 0.0f ? -std::asin(3.5f / range) : std::asin(Clamp(3.5f / range, 0.0f, 1.0f));
+            }
+            frame.radar_targets[i] = {range, noise_(random_) * 5.0f, azimuth};
+        }
+        return frame;
+    }
+
+  private:
+    std::mt19937 random_;
+    std::normal_distribution<float> noise_{0.0f, 1.0f};
+    std::uint64_t sequence_ = 0;
+    float time_ = 0.0f;
+    float ego_speed_ = 30.0f;
+    float lead_range_ = 60.0f;
+};
+
+/**
+ * Recordings start with kSensorRecordingMagic, followed by the frames one after another. Every
+ * field of a frame is written explicitly in little-endian order, floats by their IEEE 754 bits, so
+ * a recording does not depend on the layout of SensorFrame or on the compiler that wrote it. The
+ * capture time is not stored; it is set again on replay.
+*/
+static constexpr char kSensorRecordingMagic[4] = {'S', 'F', 'R', '1'};
+static constexpr std::size_t kSensorRecordBytes = 8 + 4 + 4 + SensorFrame::kMaxRadarTargets * 3 * 4 + 3 * 4;
+
+inline unsigned char* EncodeUint32(unsigned char* out, std::uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+    return out + 4;
+}
+
+inline unsigned char* EncodeFloat(unsigned char* out, float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return EncodeUint32(out, bits);
+}
+
+inline const unsigned char* DecodeUint32(const unsigned char* in, std::uint32_t& value) {
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<std::uint32_t>(in[i]) << (8 * i);
+    }
+    return in + 4;
+}
+
+inline const unsigned char* DecodeFloat(const unsigned char* in, float& value) {
+    std::uint32_t bits;
+    in = DecodeUint32(in, bits);
+    std::memcpy(&value, &bits, sizeof(value));
+    return in;
+}
+
+inline void EncodeSensorFrame(const SensorFrame& frame, unsigned char* out) {
+    out = EncodeUint32(out, static_cast<std::uint32_t>(frame.sequence));
+    out = EncodeUint32(out, static_cast<std::uint32_t>(frame.sequence >> 32));
+    out = EncodeFloat(out, frame.ego_speed_mps);
+    out = EncodeUint32(out, frame.radar_target_count);
+    for (const RadarTarget& target : frame.radar_targets) {
+        out = EncodeFloat(out, target.range_m);
+        out = EncodeFloat(out, target.range_rate_mps);
+        out = EncodeFloat(out, target.azimuth_rad);
+    }
+    out = EncodeFloat(out, frame.lane_offset_m);
+    out = EncodeFloat(out, frame.lane_heading_rad);
+    EncodeFloat(out, frame.lane_curvature_per_m);
+}
+
+// false if the record holds more radar targets than a frame can
+inline bool DecodeSensorFrame(const unsigned char* in, SensorFrame& frame) {
+    std::uint32_t sequence_low, sequence_high;
+    in = DecodeUint32(in, sequence_low);
+    in = DecodeUint32(in, sequence_high);
+    frame.sequence = static_cast<std::uint64_t>(sequence_high) << 32 | sequence_low;
+    frame.captured = std::chrono::steady_clock::time_point();
+    in = DecodeFloat(in, frame.ego_speed_mps);
+    in = DecodeUint32(in, frame.radar_target_count);
+    for (RadarTarget& target : frame.radar_targets) {
+        in = DecodeFloat(in, target.range_m);
+        in = DecodeFloat(in, target.range_rate_mps);
+        in = DecodeFloat(in, target.azimuth_rad);
+    }
+    in = DecodeFloat(in, frame.lane_offset_m);
+    in = DecodeFloat(in, frame.lane_heading_rad);
+    DecodeFloat(in, frame.lane_curvature_per_m);
+    return frame.radar_target_count <= SensorFrame::kMaxRadarTargets;
+}
+
+inline bool WriteSensorRecording(const std::string& path, const std::vector<SensorFrame>& frames) {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = std::fwrite(kSensorRecordingMagic, sizeof(kSensorRecordingMagic), 1, file) == 1;
+    unsigned char record[kSensorRecordBytes];
+    for (std::size_t i = 0; written && i < frames.size(); i++) {
+        EncodeSensorFrame(frames[i], record);
+        written = std::fwrite(record, sizeof(record), 1, file) == 1;
+    }
+    return std::fclose(file) == 0 && written;
+}
+
+// false if the file cannot be read, is not a recording, or holds no complete frame
+inline bool ReadSensorRecording(const std::string& path, std::vector<SensorFrame>& frames) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    char magic[sizeof(kSensorRecordingMagic)];
+    bool valid = std::fread(magic, sizeof(magic), 1, file) == 1 &&
+                 std::memcmp(magic, kSensorRecordingMagic, sizeof(magic)) == 0;
+    unsigned char record[kSensorRecordBytes];
+    SensorFrame frame;
+    while (valid && std::fread(record, sizeof(record), 1, file) == 1) {
+        valid = DecodeSensorFrame(record, frame);
+        if (valid) {
+            frames.push_back(frame);
+        }
+    }
+    std::fclose(file);
+    return valid && !frames.empty();
+}
+
+// bounded lock-free queue between exactly one producer thread and one consumer thread; the same
+// queue as in Builder/CarBuilder.cpp, repeated because every example builds as a single file
+template <typename T>
+class BoundedQueue {
+  private:
+    std::vector<T> slots_;
+    std::size_t mask_;
+    alignas(64) std::atomic<std::size_t> head_{0};  // next slot to pop
+    alignas(64) std::atomic<std::size_t> tail_{0};  // next slot to push
+
+  public:
+    explicit BoundedQueue(std::size_t capacity) {
+        std::size_t slot_count = 1;
+        while (slot_count < capacity) {
+            slot_count *= 2;
+        }
+        slots_.resize(slot_count);
+        mask_ = slot_count - 1;
+    }
+
+    bool TryPush(const T& value) {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+            return false;
+        }
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& value) {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
 };
 
+/**
+ * Latency of the frames from capture to control command, in buckets of a tenth of the cycle
+ * budget; the last bucket holds the frames over budget.
+*/
+struct LatencyHistogram {
+    static constexpr std::size_t kBuckets = 11;
+
+    std::chrono::nanoseconds cycle_budget;
+    std::array<std::size_t, kBuckets> counts{};
+    std::size_t frames = 0;
+    std::size_t dropped_frames = 0;
+    std::chrono::nanoseconds max_latency{0};
+
+    void Add(std::chrono::nanoseconds latency) {
+        std::size_t bucket = static_cast<std::size_t>(latency.count() * 10 / cycle_budget.count());
+        counts[bucket < kBuckets - 1 ? bucket : kBuckets - 1]++;
+        frames++;
+        max_latency = latency > max_latency ? latency : max_latency;
+    }
+
+    void Print(const std::string& name) const {
+        std::cout << name << ": " << frames << " frames, " << dropped_frames << " dropped, max latency "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(max_latency).count() << " us of "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(cycle_budget).count() << " us budget\n";
+        for (std::size_t bucket = 0; bucket < kBuckets; bucket++) {
+            if (counts[bucket] == 0) {
+                continue;
+            }
+            char line[64];
+            if (bucket < kBuckets - 1) {
+                std::snprintf(line, sizeof(line), "  %3zu-%3zu%% of budget: %zu\n", bucket * 10, bucket * 10 + 10, counts[bucket]);
+            } else {
+                std::snprintf(line, sizeof(line), "  over budget:        %zu\n", counts[bucket]);
+            }
+            std::cout << line;
+        }
+    }
+};
+
+// the control commands are stored here, so their computation is not optimized away
+volatile float control_sink = 0.0f;
+
+/**
+ * The SensorFusionPipeline runs the sensors and the driver assistance feature on two threads.
+ * The sensor thread captures one frame per cycle and hands it over through a lock-free queue; a
+ * frame is dropped when the queue is full. The processing thread computes the control command
+ * and records the latency of every frame against the cycle budget.
+*/
+class SensorFusionPipeline {
+  public:
+    SensorFusionPipeline(const DriverAssistanceFeature& driver_assistance_feature, std::chrono::microseconds cycle_budget)
+        : driver_assistance_feature_(driver_assistance_feature), cycle_budget_(cycle_budget) {
+    }
+
+    // frames come from the recording when it is not empty, from the generator otherwise
+    LatencyHistogram Run(std::size_t frame_count, const std::vector<SensorFrame>& recording) const {
+        BoundedQueue<SensorFrame> frame_queue(8);
+        std::atomic<bool> sensors_done(false);
+        LatencyHistogram latency_histogram;
+        latency_histogram.cycle_budget = cycle_budget_;
+
+        std::thread sensor_thread([&]() {
+            SensorFrameGenerator sensor_frame_generator;
+            std::chrono::steady_clock::time_point next_cycle = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < frame_count; i++) {
+                SensorFrame frame = recording.empty() ? sensor_frame_generator.Next(cycle_budget_.count() * 1e-6f) : recording[i % recording.size()];
+                next_cycle += cycle_budget_;
+                std::this_thread::sleep_until(next_cycle);
+                frame.captured = std::chrono::steady_clock::now();
+                if (!frame_queue.TryPush(frame)) {
+                    latency_histogram.dropped_frames++;
+                }
+            }
+            sensors_done.store(true, std::memory_order_release);
+        });
+
+        SensorFrame frame;
+        while (true) {
+            // read before popping: once the sensors are done, an empty queue stays empty
+            bool sensors_finished = sensors_done.load(std::memory_order_acquire);
+            if (frame_queue.TryPop(frame)) {
+                ControlCommand control_command = driver_assistance_feature_.ProcessFrame(frame);
+                latency_histogram.Add(std::chrono::steady_clock::now() - frame.captured);
+                control_sink = control_command.acceleration_mps2 + control_command.steering_angle_rad;
+            } else if (sensors_finished) {
+                break;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        sensor_thread.join();
+        return latency_histogram;
+    }
+
+  private:
+    const DriverAssistanceFeature& driver_assistance_feature_;
+    std::chrono::microseconds cycle_budget_;
+};
+
+/**
+ * Sensor mode: "--sensors [recording]" runs every feature with both suppliers through the sensor
+ * fusion pipeline on generated frames, or on the frames of a recording written with
+ * "--record-sensors <recording> <frames>".
+*/
+int RunSensorFusion(const std::string& recording_path) {
+    std::vector<SensorFrame> recording;
+    if (!recording_path.empty() && !ReadSensorRecording(recording_path, recording)) {
+        std::cerr << "Cannot read sensor recording " << recording_path << "\n";
+        return 1;
+    }
+    const std::size_t frame_count = recording.empty() ? 2000 : recording.size();
+    const std::chrono::microseconds cycle_budget(1000);
+    DriverAssistanceSystemSupplierA supplier_a;
+    DriverAssistanceSystemSupplierB supplier_b;
+    DriverAssistanceSystem* suppliers[] = {&supplier_a, &supplier_b};
+    const char* supplier_names[] = {"supplier A", "supplier B"};
+    for (std::size_t i = 0; i < 2; i++) {
+        DriverAssistanceFeature driver_assistance_feature(suppliers[i]);
+        HighwayDriverAssistanceFeature highway_feature(suppliers[i]);
+        SensorFusionPipeline(driver_assistance_feature, cycle_budget).Run(frame_count, recording).Print(std::string("Driver assistance feature, ") + supplier_names[i]);
+        SensorFusionPipeline(highway_feature, cycle_budget).Run(frame_count, recording).Print(std::string("Highway driver assistance feature, ") + supplier_names[i]);
+    }
+    return 0;
+}
+
+/**
+ * Benchmark, started with "--benchmark": processes generated frames with every feature through
+ * the runtime-polymorphic form (two virtual calls per control) and through the static form, and
+ * prints the time per frame as one JSON line per case.
+*/
+template <typename ProcessFrame>
+void RunBenchmarkCase(const std::string& feature, const std::string& supplier, const std::string& form,
+                      const std::vector<SensorFrame>& frames, std::size_t frame_count, ProcessFrame process_frame) {
+    float control_sum = 0.0f;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::size_t frame_index = 0;
+    for (std::size_t i = 0; i < frame_count; i++) {
+        ControlCommand control_command = process_frame(frames[frame_index]);
+        control_sum += control_command.acceleration_mps2 + control_command.steering_angle_rad;
+        frame_index = frame_index + 1 == frames.size() ? 0 : frame_index + 1;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    control_sink = control_sum;
+
+    std::cout << "{\"benchmark\": \"bridge\""
+              << ", \"feature\": \"" << feature << "\""
+              << ", \"supplier\": \"" << supplier << "\""
+              << ", \"form\": \"" << form << "\""
+              << ", \"frames\": " << frame_count
+              << ", \"ns_per_frame\": " << elapsed.count() * 1e9 / frame_count
+              << "}" << std::endl;
+}
+
+template <typename ConcreteDriverAssistanceSystem>
+void BenchmarkSupplier(const std::string& supplier, const std::vector<SensorFrame>& frames, std::size_t frame_count) {
+    ConcreteDriverAssistanceSystem driver_assistance_system;
+    DriverAssistanceFeature driver_assistance_feature(&driver_assistance_system);
+    HighwayDriverAssistanceFeature highway_feature(&driver_assistance_system);
+    const DriverAssistanceFeature& runtime_feature = driver_assistance_feature;
+    const DriverAssistanceFeature& runtime_highway_feature = highway_feature;
+    RunBenchmarkCase("DriverAssistanceFeature", supplier, "Runtime", frames, frame_count, [&](const SensorFrame& frame) {
+        return runtime_feature.ProcessFrame(frame);
+    });
+    StaticDriverAssistanceFeature<ConcreteDriverAssistanceSystem> static_feature;
+    RunBenchmarkCase("DriverAssistanceFeature", supplier, "Static", frames, frame_count, [&](const SensorFrame& frame) {
+        return static_feature.ProcessFrame(frame);
+    });
+    RunBenchmarkCase("HighwayDriverAssistanceFeature", supplier, "Runtime", frames, frame_count, [&](const SensorFrame& frame) {
+        return runtime_highway_feature.ProcessFrame(frame);
+    });
+    StaticHighwayDriverAssistanceFeature<ConcreteDriverAssistanceSystem> static_highway_feature;
+    RunBenchmarkCase("HighwayDriverAssistanceFeature", supplier, "Static", frames, frame_count, [&](const SensorFrame& frame) {
+        return static_highway_feature.ProcessFrame(frame);
+    });
+}
+
+void RunBenchmarks() {
+    const std::size_t frame_count = 20000000;
+    SensorFrameGenerator sensor_frame_generator;
+    std::vector<SensorFrame> frames;
+    for (std::size_t i = 0; i < 1024; i++) {
+        frames.push_back(sensor_frame_generator.Next(0.001f));
+    }
+    BenchmarkSupplier<DriverAssistanceSystemSupplierA>("SupplierA", frames, frame_count);
+    BenchmarkSupplier<DriverAssistanceSystemSupplierB>("SupplierB", frames, frame_count);
+}
+
 /**
  * The client code only depends on the DriverAssistanceFeature class (abstraction).
 */
@@ -107,7 +708,26 @@ void ClientCode(const DriverAssistanceFeature& driver_assistance_feature) {
 /**
  * main code
 */
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        RunBenchmarks();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--sensors") {
+        return RunSensorFusion(argc > 2 ? argv[2] : "");
+    }
+    if (argc > 3 && std::string(argv[1]) == "--record-sensors") {
+        SensorFrameGenerator sensor_frame_generator;
+        std::vector<SensorFrame> frames;
+        for (std::size_t i = 0; i < std::stoul(argv[3]); i++) {
+            frames.push_back(sensor_frame_generator.Next(0.001f));
+        }
+        if (!WriteSensorRecording(argv[2], frames)) {
+            std::cerr << "Cannot write sensor recording " << argv[2] << "\n";
+            return 1;
+        }
+        return 0;
+    }
     DriverAssistanceSystem* da_system = new DriverAssistanceSystemSupplierA;
     DriverAssistanceFeature* da_feature = new DriverAssistanceFeature(da_system);
     ClientCode(*da_feature);
@@ -143,5 +763,9 @@ int main() {
     delete da_system;
     delete da_feature;
 
+    StaticHighwayDriverAssistanceFeature<DriverAssistanceSystemSupplierA> static_feature;
+    std::cout << static_feature.AssistanceOperation();
+    std::cout << std::endl;
+
     return 0;
 }
\ No newline at end of file
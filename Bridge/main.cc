@@ -84,6 +84,33 @@ class ExtendedAbstraction : public Abstraction {
   }
 };
 
+/**
+ * The static form of the Abstraction is a template on the Concrete Implementation,
+ * which it holds by value. The Implementation is then fixed at compile time and
+ * its operation can be inlined into the Abstraction; the runtime form above
+ * remains for combinations chosen while the program runs.
+ */
+template <typename ConcreteImplementation>
+class StaticAbstraction {
+ protected:
+  ConcreteImplementation implementation_;
+
+ public:
+  std::string Operation() const {
+    return "Abstraction: Base operation with:\n" +
+           this->implementation_.OperationImplementation();
+  }
+};
+
+template <typename ConcreteImplementation>
+class StaticExtendedAbstraction : public StaticAbstraction<ConcreteImplementation> {
+ public:
+  std::string Operation() const {
+    return "ExtendedAbstraction: Extended operation with:\n" +
+           this->implementation_.OperationImplementation();
+  }
+};
+
 /**
  * Except for the initialization phase, where an Abstraction object gets linked
  * with a specific Implementation object, the client code should only depend on
@@ -115,5 +142,9 @@ int main() {
   delete implementation;
   delete abstraction;
 
+  std::cout << std::endl;
+  StaticExtendedAbstraction<ConcreteImplementationA> static_abstraction;
+  std::cout << static_abstraction.Operation();
+
   return 0;
 }
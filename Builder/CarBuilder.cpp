@@ -1,5 +1,21 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 // product
@@ -18,6 +34,51 @@ public:
         }
         std::cout << "\n\n";
     }
+
+    void WriteParts(std::ostream& out) const {
+        for (std::size_t i = 0; i < parts_.size(); i++) {
+            out << parts_[i] << (i + 1 < parts_.size() ? ", " : "");
+        }
+    }
+};
+
+
+// car pool: finished cars are released back to the pool instead of being deleted, and are handed
+// out again with their part list cleared but its capacity kept. Once the pool holds enough cars,
+// building a car allocates nothing.
+class CarPool {
+private:
+    std::vector<Car*> free_cars_;
+    std::size_t part_capacity_;
+
+public:
+    explicit CarPool(std::size_t part_capacity = 8) : part_capacity_(part_capacity) {
+    }
+
+    CarPool(const CarPool& other) = delete;
+    void operator=(const CarPool&) = delete;
+
+    ~CarPool() {
+        for (Car* car : free_cars_) {
+            delete car;
+        }
+    }
+
+    Car* Acquire() {
+        if (free_cars_.empty()) {
+            Car* car = new Car();
+            car->parts_.reserve(part_capacity_);
+            return car;
+        }
+        Car* car = free_cars_.back();
+        free_cars_.pop_back();
+        return car;
+    }
+
+    void Release(Car* car) {
+        car->parts_.clear();
+        free_cars_.push_back(car);
+    }
 };
 
 
@@ -36,18 +97,33 @@ public:
 class SmallCarBuilder : public CarBuilder {
 private:
     Car* car;
+    CarPool* car_pool = nullptr;
 
 public:
     SmallCarBuilder() {
         this->Reset();
     }
 
+    // pooled mode: cars come from the pool, and are released back to it instead of deleted
+    explicit SmallCarBuilder(CarPool* car_pool) : car_pool(car_pool) {
+        this->Reset();
+    }
+
     ~SmallCarBuilder() {
-        delete car;
+        if (car_pool != nullptr) {
+            car_pool->Release(car);
+        } else {
+            delete car;
+        }
     }
 
     void Reset() {
-        this->car = new Car();
+        this->car = car_pool != nullptr ? car_pool->Acquire() : new Car();
+    }
+
+    // sizes the part list of the car under construction, so the following steps do not reallocate it
+    void ReserveParts(std::size_t part_count) {
+        this->car->parts_.reserve(part_count);
     }
 
     void ProduceBody() const override {
@@ -78,18 +154,33 @@ public:
 class LargeCarBuilder : public CarBuilder {
 private:
     Car* car;
+    CarPool* car_pool = nullptr;
 
 public:
     LargeCarBuilder() {
         this->Reset();
     }
 
+    // pooled mode: cars come from the pool, and are released back to it instead of deleted
+    explicit LargeCarBuilder(CarPool* car_pool) : car_pool(car_pool) {
+        this->Reset();
+    }
+
     ~LargeCarBuilder() {
-        delete car;
+        if (car_pool != nullptr) {
+            car_pool->Release(car);
+        } else {
+            delete car;
+        }
     }
 
     void Reset() {
-        this->car = new Car();
+        this->car = car_pool != nullptr ? car_pool->Acquire() : new Car();
+    }
+
+    // sizes the part list of the car under construction, so the following steps do not reallocate it
+    void ReserveParts(std::size_t part_count) {
+        this->car->parts_.reserve(part_count);
     }
 
     void ProduceBody() const override {
@@ -116,10 +207,115 @@ public:
 };
 
 
+// build plan: a build recorded once by the director as a compact list of instructions. Repeated
+// steps are stored once with a count. Unlike the director, the plan knows how many parts a car
+// gets before the first step runs, so replaying it sizes the part list of the car once instead of
+// growing it step by step, and calls the concrete builder directly instead of through the director.
+enum class BuildInstruction : unsigned char {
+    kBody,
+    kEngine,
+    kSeat,
+    kWheel
+};
+
+class BuildPlan {
+private:
+    struct Step {
+        BuildInstruction instruction;
+        unsigned char count;
+    };
+    std::vector<Step> steps_;
+    std::size_t part_count_ = 0;
+
+public:
+    void Record(BuildInstruction instruction) {
+        if (!steps_.empty() && steps_.back().instruction == instruction && steps_.back().count < 255) {
+            steps_.back().count++;
+        } else {
+            steps_.push_back({instruction, 1});
+        }
+        part_count_++;
+    }
+
+    std::size_t size() const {
+        return steps_.size();
+    }
+
+    std::size_t part_count() const {
+        return part_count_;
+    }
+
+    template <typename ConcreteCarBuilder>
+    void Replay(ConcreteCarBuilder& car_builder) const {
+        car_builder.ReserveParts(part_count_);
+        for (const Step& step : steps_) {
+            for (unsigned char i = 0; i < step.count; i++) {
+                switch (step.instruction) {
+                    case BuildInstruction::kBody: car_builder.ConcreteCarBuilder::ProduceBody(); break;
+                    case BuildInstruction::kEngine: car_builder.ConcreteCarBuilder::ProduceEngine(); break;
+                    case BuildInstruction::kSeat: car_builder.ConcreteCarBuilder::ProduceSeat(); break;
+                    case BuildInstruction::kWheel: car_builder.ConcreteCarBuilder::ProduceWheel(); break;
+                }
+            }
+        }
+    }
+
+    // builds car_count cars in one call, the caller owns the returned cars. A builder in pooled mode
+    // takes the cars from its pool, where they keep their part capacity, so a warm pool allocates nothing.
+    template <typename ConcreteCarBuilder>
+    std::vector<Car*> ReplayBatch(ConcreteCarBuilder& car_builder, std::size_t car_count) const {
+        std::vector<Car*> cars;
+        cars.reserve(car_count);
+        for (std::size_t i = 0; i < car_count; i++) {
+            this->Replay(car_builder);
+            cars.push_back(car_builder.GetCar());
+        }
+        return cars;
+    }
+};
+
+
+// builder which records the build steps into a build plan instead of producing parts
+class RecordingCarBuilder : public CarBuilder {
+private:
+    BuildPlan* plan;
+
+public:
+    RecordingCarBuilder(BuildPlan* plan) : plan(plan) {
+    }
+
+    void ProduceBody() const override {
+        this->plan->Record(BuildInstruction::kBody);
+    }
+
+    void ProduceEngine() const override {
+        this->plan->Record(BuildInstruction::kEngine);
+    }
+
+    void ProduceSeat() const override {
+        this->plan->Record(BuildInstruction::kSeat);
+    }
+
+    void ProduceWheel() const override {
+        this->plan->Record(BuildInstruction::kWheel);
+    }
+};
+
+
 // director
 class Director {
 private:
-    CarBuilder* car_builder;
+    CarBuilder* car_builder = nullptr;
+
+    BuildPlan Record(void (Director::*build)()) {
+        BuildPlan plan;
+        RecordingCarBuilder recording_builder(&plan);
+        CarBuilder* current_builder = this->car_builder;
+        this->car_builder = &recording_builder;
+        (this->*build)();
+        this->car_builder = current_builder;
+        return plan;
+    }
 
 public:
     void set_builder(CarBuilder* car_builder) {
@@ -142,8 +338,475 @@ public:
         this->car_builder->ProduceSeat();
         this->car_builder->ProduceWheel();
     }
+
+    BuildPlan RecordLowLevelCar() {
+        return this->Record(&Director::BuildLowLevelCar);
+    }
+
+    BuildPlan RecordHighLevelCar() {
+        return this->Record(&Director::BuildHighLevelCar);
+    }
+};
+
+
+// bounded lock-free queue between exactly one producer thread and one consumer thread
+template <typename T>
+class BoundedQueue {
+private:
+    std::vector<T> slots_;
+    std::size_t mask_;
+    alignas(64) std::atomic<std::size_t> head_{0};  // next slot to pop
+    alignas(64) std::atomic<std::size_t> tail_{0};  // next slot to push
+
+public:
+    explicit BoundedQueue(std::size_t capacity) {
+        std::size_t slot_count = 1;
+        while (slot_count < capacity) {
+            slot_count *= 2;
+        }
+        slots_.resize(slot_count);
+        mask_ = slot_count - 1;
+    }
+
+    bool TryPush(const T& value) {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+            return false;
+        }
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& value) {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    void Push(const T& value) {
+        while (!this->TryPush(value)) {
+            std::this_thread::yield();
+        }
+    }
+
+    T Pop() {
+        T value;
+        while (!this->TryPop(value)) {
+            std::this_thread::yield();
+        }
+        return value;
+    }
+
+    std::size_t size() const {
+        std::size_t head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+};
+
+
+// statistics of one stage of the pipelined director
+struct StageStatistics {
+    std::string step;
+    std::size_t cars = 0;
+    double busy_seconds = 0.0;
+    std::size_t queue_occupancy_sum = 0;
+    std::size_t queue_occupancy_max = 0;
+};
+
+
+// pipelined director: every build step runs as its own stage on a dedicated thread. The cars in
+// flight travel through the stages inside their builders, connected by bounded lock-free queues.
+// The last stage takes the finished car and sends the builder back to the first stage.
+template <typename ConcreteCarBuilder>
+class PipelinedDirector {
+private:
+    struct BuildStep {
+        const char* name;
+        void (CarBuilder::*produce)() const;
+    };
+
+    std::size_t cars_in_flight_;
+    std::vector<StageStatistics> statistics_;
+    double elapsed_seconds_ = 0.0;
+
+    std::vector<Car*> Build(const std::vector<BuildStep>& steps, std::size_t car_count) {
+        // queue i feeds stage i, queue 0 holds the free builders
+        std::vector<std::unique_ptr<BoundedQueue<ConcreteCarBuilder*>>> queues;
+        for (std::size_t i = 0; i < steps.size(); i++) {
+            queues.emplace_back(new BoundedQueue<ConcreteCarBuilder*>(cars_in_flight_));
+        }
+        std::vector<std::unique_ptr<ConcreteCarBuilder>> car_builders;
+        for (std::size_t i = 0; i < cars_in_flight_; i++) {
+            car_builders.emplace_back(new ConcreteCarBuilder());
+            queues[0]->Push(car_builders.back().get());
+        }
+
+        std::vector<Car*> cars;
+        cars.reserve(car_count);
+        statistics_.assign(steps.size(), StageStatistics());
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> stages;
+        for (std::size_t stage = 0; stage < steps.size(); stage++) {
+            stages.emplace_back([&, stage]() {
+                StageStatistics& statistics = statistics_[stage];
+                statistics.step = steps[stage].name;
+                BoundedQueue<ConcreteCarBuilder*>& input = *queues[stage];
+                BoundedQueue<ConcreteCarBuilder*>& output = *queues[(stage + 1) % steps.size()];
+                for (std::size_t i = 0; i < car_count; i++) {
+                    ConcreteCarBuilder* car_builder = input.Pop();
+                    std::size_t occupancy = input.size() + 1;
+                    statistics.queue_occupancy_sum += occupancy;
+                    statistics.queue_occupancy_max = std::max(statistics.queue_occupancy_max, occupancy);
+
+                    std::chrono::steady_clock::time_point step_start = std::chrono::steady_clock::now();
+                    (car_builder->*steps[stage].produce)();
+                    if (stage + 1 == steps.size()) {
+                        cars.push_back(car_builder->GetCar());
+                    }
+                    statistics.busy_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - step_start).count();
+                    statistics.cars++;
+                    output.Push(car_builder);
+                }
+            });
+        }
+        for (std::thread& stage : stages) {
+            stage.join();
+        }
+        elapsed_seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return cars;
+    }
+
+public:
+    explicit PipelinedDirector(std::size_t cars_in_flight) : cars_in_flight_(std::max<std::size_t>(1, cars_in_flight)) {
+    }
+
+    // the caller owns the returned cars
+    std::vector<Car*> BuildLowLevelCars(std::size_t car_count) {
+        return this->Build({{"body", &CarBuilder::ProduceBody},
+                            {"engine", &CarBuilder::ProduceEngine},
+                            {"seat", &CarBuilder::ProduceSeat},
+                            {"wheel", &CarBuilder::ProduceWheel}}, car_count);
+    }
+
+    std::vector<Car*> BuildHighLevelCars(std::size_t car_count) {
+        return this->Build({{"body", &CarBuilder::ProduceBody},
+                            {"engine", &CarBuilder::ProduceEngine},
+                            {"seat 1", &CarBuilder::ProduceSeat},
+                            {"seat 2", &CarBuilder::ProduceSeat},
+                            {"seat 3", &CarBuilder::ProduceSeat},
+                            {"seat 4", &CarBuilder::ProduceSeat},
+                            {"wheel", &CarBuilder::ProduceWheel}}, car_count);
+    }
+
+    const std::vector<StageStatistics>& statistics() const {
+        return statistics_;
+    }
+
+    // the stage with the highest busy share is the bottleneck of the pipeline
+    void ReportStages() const {
+        for (const StageStatistics& statistics : statistics_) {
+            std::cout << "Stage " << statistics.step << ": "
+                      << statistics.cars / elapsed_seconds_ << " cars/s, "
+                      << 100.0 * statistics.busy_seconds / elapsed_seconds_ << "% busy, queue occupancy avg "
+                      << static_cast<double>(statistics.queue_occupancy_sum) / std::max<std::size_t>(1, statistics.cars)
+                      << " max " << statistics.queue_occupancy_max << "\n";
+        }
+        std::cout << "\n";
+    }
+};
+
+
+// car builder service for concurrent order processing. Any number of producer threads submit
+// requests for cars to one queue served by a fixed set of worker threads. A request is split into
+// chunks of kChunkSize cars, so a large request is spread over all workers while the requests of
+// several producers are served side by side. A builder must never be shared between threads (its
+// const Produce* methods still modify the car), so every worker owns its builder and director. A
+// worker writes the cars of a chunk into the slots of its request, and the worker finishing the
+// last chunk hands the cars to the submitter through the future; the lock is taken once per chunk.
+template <typename ConcreteCarBuilder>
+class CarBuilderService {
+private:
+    static constexpr std::size_t kChunkSize = 256;
+
+    struct Request {
+        void (Director::*build)();
+        std::vector<Car*> cars;
+        std::atomic<std::size_t> remaining_chunks{0};
+        std::promise<std::vector<Car*>> result;
+    };
+
+    struct Chunk {
+        std::shared_ptr<Request> request;
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable chunk_available_;
+    std::deque<Chunk> chunks_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+
+    void Work() {
+        ConcreteCarBuilder car_builder;
+        Director director;
+        director.set_builder(&car_builder);
+        for (;;) {
+            Chunk chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                chunk_available_.wait(lock, [this]() { return stopping_ || !chunks_.empty(); });
+                if (chunks_.empty()) {
+                    return;
+                }
+                chunk = std::move(chunks_.front());
+                chunks_.pop_front();
+            }
+            Request& request = *chunk.request;
+            for (std::size_t i = chunk.begin; i < chunk.end; i++) {
+                (director.*request.build)();
+                request.cars[i] = car_builder.GetCar();
+            }
+            if (request.remaining_chunks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                request.result.set_value(std::move(request.cars));
+            }
+        }
+    }
+
+    std::future<std::vector<Car*>> Submit(std::size_t car_count, void (Director::*build)()) {
+        std::shared_ptr<Request> request = std::make_shared<Request>();
+        request->build = build;
+        request->cars.resize(car_count);
+        std::future<std::vector<Car*>> result = request->result.get_future();
+        if (car_count == 0) {
+            request->result.set_value({});
+            return result;
+        }
+        request->remaining_chunks.store((car_count + kChunkSize - 1) / kChunkSize, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (std::size_t begin = 0; begin < car_count; begin += kChunkSize) {
+                chunks_.push_back({request, begin, std::min(begin + kChunkSize, car_count)});
+            }
+        }
+        chunk_available_.notify_all();
+        return result;
+    }
+
+public:
+    explicit CarBuilderService(std::size_t thread_count) {
+        thread_count = std::max<std::size_t>(1, thread_count);
+        workers_.reserve(thread_count);
+        for (std::size_t worker = 0; worker < thread_count; worker++) {
+            workers_.emplace_back(&CarBuilderService::Work, this);
+        }
+    }
+
+    CarBuilderService(const CarBuilderService& other) = delete;
+    void operator=(const CarBuilderService&) = delete;
+
+    // requests already submitted are still built before the workers stop
+    ~CarBuilderService() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        chunk_available_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    // safe to call from any number of threads, the caller owns the cars of the future
+    std::future<std::vector<Car*>> SubmitLowLevelCars(std::size_t car_count) {
+        return this->Submit(car_count, &Director::BuildLowLevelCar);
+    }
+
+    std::future<std::vector<Car*>> SubmitHighLevelCars(std::size_t car_count) {
+        return this->Submit(car_count, &Director::BuildHighLevelCar);
+    }
+
+    // the caller owns the returned cars
+    std::vector<Car*> BuildLowLevelCars(std::size_t car_count) {
+        return this->SubmitLowLevelCars(car_count).get();
+    }
+
+    std::vector<Car*> BuildHighLevelCars(std::size_t car_count) {
+        return this->SubmitHighLevelCars(car_count).get();
+    }
+};
+
+
+// part kinds of the statically laid out car
+enum class CarPart : unsigned char {
+    kSmallBody,
+    kLargeBody,
+    kSmallEngine,
+    kLargeEngine,
+    kNormalSeat,
+    kNormalWheel
+};
+
+inline const char* CarPartName(CarPart part) {
+    switch (part) {
+        case CarPart::kSmallBody: return "Small body";
+        case CarPart::kLargeBody: return "Large body";
+        case CarPart::kSmallEngine: return "Small engine";
+        case CarPart::kLargeEngine: return "Large engine";
+        case CarPart::kNormalSeat: return "Normal seat";
+        case CarPart::kNormalWheel: return "Normal wheel";
+    }
+    return "Unknown part";
+}
+
+
+// product with a layout fixed at compile time, no heap allocation
+template <std::size_t kPartCount>
+class StaticCar {
+public:
+    std::array<CarPart, kPartCount> parts_{};
+
+    void ListParts() const {
+        std::cout << "Car parts: ";
+        for (std::size_t i = 0; i < parts_.size(); i++) {
+            std::cout << CarPartName(parts_[i]) << (i + 1 < parts_.size() ? ", " : "");
+        }
+        std::cout << "\n\n";
+    }
+};
+
+
+// part sets of the small and large car, used as template parameter of the static builder
+struct SmallCarParts {
+    static constexpr CarPart kBody = CarPart::kSmallBody;
+    static constexpr CarPart kEngine = CarPart::kSmallEngine;
+    static constexpr CarPart kSeat = CarPart::kNormalSeat;
+    static constexpr CarPart kWheel = CarPart::kNormalWheel;
+};
+
+struct LargeCarParts {
+    static constexpr CarPart kBody = CarPart::kLargeBody;
+    static constexpr CarPart kEngine = CarPart::kLargeEngine;
+    static constexpr CarPart kSeat = CarPart::kNormalSeat;
+    static constexpr CarPart kWheel = CarPart::kNormalWheel;
+};
+
+
+// build steps of the static builder, a director lists them once and the part count follows from the list
+enum class StaticBuildStep {
+    kBody,
+    kEngine,
+    kSeat,
+    kWheel
+};
+
+
+// static builder: the part set and the number of parts are template parameters, so all calls
+// are resolved at compile time and can be inlined. A step past the last part or a car taken with
+// parts missing throws, which is a compile error when the car is built in a constant expression.
+template <typename CarParts, std::size_t kPartCount>
+class StaticCarBuilder {
+private:
+    StaticCar<kPartCount> car_;
+    std::size_t next_part_ = 0;
+
+    constexpr void AddPart(CarPart part) {
+        if (next_part_ == kPartCount) {
+            throw std::out_of_range("StaticCarBuilder: more build steps than car parts");
+        }
+        car_.parts_[next_part_++] = part;
+    }
+
+public:
+    constexpr void ProduceBody() {
+        AddPart(CarParts::kBody);
+    }
+
+    constexpr void ProduceEngine() {
+        AddPart(CarParts::kEngine);
+    }
+
+    constexpr void ProduceSeat() {
+        AddPart(CarParts::kSeat);
+    }
+
+    constexpr void ProduceWheel() {
+        AddPart(CarParts::kWheel);
+    }
+
+    constexpr void Produce(StaticBuildStep step) {
+        switch (step) {
+        case StaticBuildStep::kBody:
+            ProduceBody();
+            break;
+        case StaticBuildStep::kEngine:
+            ProduceEngine();
+            break;
+        case StaticBuildStep::kSeat:
+            ProduceSeat();
+            break;
+        case StaticBuildStep::kWheel:
+            ProduceWheel();
+            break;
+        }
+    }
+
+    constexpr StaticCar<kPartCount> GetCar() {
+        if (next_part_ != kPartCount) {
+            throw std::logic_error("StaticCarBuilder: car taken before all parts were produced");
+        }
+        next_part_ = 0;
+        return car_;
+    }
+};
+
+
+// static director, follows the same build steps as the director above
+class StaticDirector {
+public:
+    static constexpr StaticBuildStep kLowLevelSteps[] = {
+        StaticBuildStep::kBody, StaticBuildStep::kEngine, StaticBuildStep::kSeat, StaticBuildStep::kWheel
+    };
+    static constexpr StaticBuildStep kHighLevelSteps[] = {
+        StaticBuildStep::kBody, StaticBuildStep::kEngine, StaticBuildStep::kSeat, StaticBuildStep::kSeat,
+        StaticBuildStep::kSeat, StaticBuildStep::kSeat, StaticBuildStep::kWheel
+    };
+    static constexpr std::size_t kLowLevelPartCount = std::size(kLowLevelSteps);
+    static constexpr std::size_t kHighLevelPartCount = std::size(kHighLevelSteps);
+
+    template <typename CarParts>
+    static constexpr StaticCar<kLowLevelPartCount> BuildLowLevelCar() {
+        return Build<CarParts>(kLowLevelSteps);
+    }
+
+    template <typename CarParts>
+    static constexpr StaticCar<kHighLevelPartCount> BuildHighLevelCar() {
+        return Build<CarParts>(kHighLevelSteps);
+    }
+
+    // builds a car from any step list, one part per step
+    template <typename CarParts, std::size_t kStepCount>
+    static constexpr StaticCar<kStepCount> Build(const StaticBuildStep (&steps)[kStepCount]) {
+        StaticCarBuilder<CarParts, kStepCount> car_builder;
+        for (StaticBuildStep step : steps) {
+            car_builder.Produce(step);
+        }
+        return car_builder.GetCar();
+    }
 };
 
+// both builds run once at compile time, so a step list that does not fill its car fails to compile
+static_assert(StaticDirector::BuildLowLevelCar<SmallCarParts>().parts_[StaticDirector::kLowLevelPartCount - 1] == CarPart::kNormalWheel,
+              "low level car must end with its wheels");
+static_assert(StaticDirector::BuildHighLevelCar<LargeCarParts>().parts_[StaticDirector::kHighLevelPartCount - 1] == CarPart::kNormalWheel,
+              "high level car must end with its wheels");
+
 
 // client
 void ClientCode(Director& director) {
@@ -183,10 +846,389 @@ void ClientCode(Director& director) {
     high_lvl_car = large_car_builder->GetCar();
     high_lvl_car->ListParts();
     delete high_lvl_car;
+
+
+
+    std::cout << "Small high level car with static builder:\n";
+    StaticDirector::BuildHighLevelCar<SmallCarParts>().ListParts();
+
+    std::cout << "Large low level car with static builder:\n";
+    constexpr StaticCar<StaticDirector::kLowLevelPartCount> static_car = StaticDirector::BuildLowLevelCar<LargeCarParts>();
+    static_car.ListParts();
+
+
+    std::cout << "1000 small high level cars with pipelined director:\n";
+    PipelinedDirector<SmallCarBuilder> pipelined_director(16);
+    std::vector<Car*> cars = pipelined_director.BuildHighLevelCars(1000);
+    cars.front()->ListParts();
+    pipelined_director.ReportStages();
+    for (Car* car : cars) {
+        delete car;
+    }
+
+
+    std::cout << "10000 large high level cars from a recorded build plan:\n";
+    BuildPlan high_level_plan = director.RecordHighLevelCar();
+    LargeCarBuilder plan_car_builder;
+    cars = high_level_plan.ReplayBatch(plan_car_builder, 10000);
+    std::cout << cars.size() << " cars built from " << high_level_plan.size() << " plan steps\n";
+    cars.back()->ListParts();
+    for (Car* car : cars) {
+        delete car;
+    }
+
+
+    std::cout << "Small low level cars with pooled builder:\n";
+    CarPool car_pool;
+    {
+        SmallCarBuilder pooled_car_builder(&car_pool);
+        director.set_builder(&pooled_car_builder);
+        for (int i = 0; i < 3; i++) {
+            director.BuildLowLevelCar();
+            Car* pooled_car = pooled_car_builder.GetCar();
+            pooled_car->ListParts();
+            car_pool.Release(pooled_car);
+        }
+    }
+
+
+    std::cout << "Large high level cars with builder service:\n";
+    CarBuilderService<LargeCarBuilder> car_builder_service(std::max(1u, std::thread::hardware_concurrency()));
+    cars = car_builder_service.BuildHighLevelCars(1000);
+    std::cout << cars.size() << " cars built\n";
+    cars.front()->ListParts();
+    for (Car* car : cars) {
+        delete car;
+    }
+}
+
+
+// order of the streaming batch mode, one line "<small|large> <low|high>" per car in the order file
+struct CarOrder {
+    bool large = false;
+    bool high_level = false;
+};
+
+bool ParseCarOrder(const std::string& line, CarOrder& order) {
+    std::size_t separator = line.find(' ');
+    if (separator == std::string::npos) {
+        return false;
+    }
+    std::string size = line.substr(0, separator);
+    std::string level = line.substr(separator + 1);
+    if ((size != "small" && size != "large") || (level != "low" && level != "high")) {
+        return false;
+    }
+    order.large = (size == "large");
+    order.high_level = (level == "high");
+    return true;
+}
+
+struct FinishedCar {
+    CarOrder order;
+    Car* car;   // nullptr marks the end of the stream
+};
+
+
+// streaming batch mode, started with "--orders <order file> <output file>": reader and writer run
+// on their own threads and the builder on the calling thread, connected by bounded queues. A full queue blocks its producer
+// (backpressure), so only a bounded number of orders and cars are in memory, no matter how large
+// the order file is.
+int ProcessOrderFile(const std::string& order_path, const std::string& output_path) {
+    std::ifstream order_file(order_path);
+    if (!order_file) {
+        std::cerr << "Cannot open order file " << order_path << "\n";
+        return 1;
+    }
+    std::ofstream output_file(output_path);
+    if (!output_file) {
+        std::cerr << "Cannot open output file " << output_path << "\n";
+        return 1;
+    }
+
+    const std::size_t queue_capacity = 4096;
+    BoundedQueue<std::pair<CarOrder, bool>> orders(queue_capacity);   // second is false at the end
+    BoundedQueue<FinishedCar> finished_cars(queue_capacity);
+    std::size_t invalid_lines = 0;
+    std::size_t processed_orders = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::thread reader([&]() {
+        std::string line;
+        CarOrder order;
+        while (std::getline(order_file, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();   // order file with CRLF line endings
+            }
+            if (ParseCarOrder(line, order)) {
+                orders.Push({order, true});
+            } else if (!line.empty()) {
+                invalid_lines++;
+            }
+        }
+        orders.Push({CarOrder(), false});
+    });
+
+    std::thread writer([&]() {
+        for (FinishedCar finished_car = finished_cars.Pop(); finished_car.car != nullptr; finished_car = finished_cars.Pop()) {
+            output_file << (finished_car.order.large ? "large " : "small ") << (finished_car.order.high_level ? "high: " : "low: ");
+            finished_car.car->WriteParts(output_file);
+            output_file << "\n";
+            delete finished_car.car;
+            processed_orders++;
+        }
+    });
+
+    // builder stage on the calling thread
+    Director director;
+    SmallCarBuilder small_car_builder;
+    LargeCarBuilder large_car_builder;
+    for (std::pair<CarOrder, bool> order = orders.Pop(); order.second; order = orders.Pop()) {
+        director.set_builder(order.first.large ? static_cast<CarBuilder*>(&large_car_builder) : &small_car_builder);
+        if (order.first.high_level) {
+            director.BuildHighLevelCar();
+        } else {
+            director.BuildLowLevelCar();
+        }
+        Car* car = order.first.large ? large_car_builder.GetCar() : small_car_builder.GetCar();
+        finished_cars.Push({order.first, car});
+    }
+    finished_cars.Push({CarOrder(), nullptr});
+
+    reader.join();
+    writer.join();
+    output_file.flush();
+    if (!output_file) {
+        std::cerr << "Cannot write output file " << output_path << "\n";
+        return 1;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Processed " << processed_orders << " orders in " << elapsed.count() << " s ("
+              << processed_orders / elapsed.count() << " orders/s), skipped " << invalid_lines << " invalid lines\n";
+    return 0;
+}
+
+
+// benchmark, started with "--benchmark": builds millions of cars with the dynamic and the static
+// builder, and prints time and heap allocations per car as one JSON line per case
+
+// heap allocations are counted per thread, each thread in a counter on its own cache line, so the
+// workers of the builder service do not contend on one counter; AllocationCount adds them up
+struct alignas(64) AllocationCounter {
+    std::atomic<std::size_t> count{0};
+};
+
+constexpr std::size_t kAllocationCounterCount = 64;
+AllocationCounter allocation_counters[kAllocationCounterCount];
+std::atomic<std::size_t> next_allocation_counter(0);
+
+std::size_t AllocationCount() {
+    std::size_t count = 0;
+    for (const AllocationCounter& counter : allocation_counters) {
+        count += counter.count.load(std::memory_order_relaxed);
+    }
+    return count;
 }
 
+// the replaced operator new and delete below pair malloc with free, which GCC cannot see through
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+    thread_local AllocationCounter& counter =
+        allocation_counters[next_allocation_counter.fetch_add(1, std::memory_order_relaxed) % kAllocationCounterCount];
+    counter.count.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+// the result of every build is stored here, so the builds are not optimized away
+volatile std::size_t benchmark_sink = 0;
+
+template <typename BuildCar>
+void RunBenchmarkCase(const std::string& builder, const std::string& level, std::size_t car_count, BuildCar build_car) {
+    std::size_t allocations_before = AllocationCount();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < car_count; i++) {
+        benchmark_sink = build_car();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::size_t allocations = AllocationCount() - allocations_before;
+
+    std::cout << "{\"benchmark\": \"car_builder\""
+              << ", \"builder\": \"" << builder << "\""
+              << ", \"level\": \"" << level << "\""
+              << ", \"cars\": " << car_count
+              << ", \"ns_per_car\": " << elapsed.count() * 1e9 / car_count
+              << ", \"cars_per_second\": " << car_count / elapsed.count()
+              << ", \"allocations_per_car\": " << static_cast<double>(allocations) / car_count
+              << "}" << std::endl;
+}
+
+template <typename DynamicCarBuilder, typename CarParts>
+void BenchmarkCarBuilder(const std::string& builder, std::size_t car_count) {
+    Director director;
+    DynamicCarBuilder car_builder;
+    director.set_builder(&car_builder);
+
+    RunBenchmarkCase(builder, "low", car_count, [&]() {
+        director.BuildLowLevelCar();
+        Car* car = car_builder.GetCar();
+        std::size_t part_count = car->parts_.size();
+        delete car;
+        return part_count;
+    });
+    RunBenchmarkCase(builder, "high", car_count, [&]() {
+        director.BuildHighLevelCar();
+        Car* car = car_builder.GetCar();
+        std::size_t part_count = car->parts_.size();
+        delete car;
+        return part_count;
+    });
+
+    CarPool car_pool;
+    DynamicCarBuilder pooled_car_builder(&car_pool);
+    director.set_builder(&pooled_car_builder);
+    RunBenchmarkCase("Pooled" + builder, "low", car_count, [&]() {
+        director.BuildLowLevelCar();
+        Car* car = pooled_car_builder.GetCar();
+        std::size_t part_count = car->parts_.size();
+        car_pool.Release(car);
+        return part_count;
+    });
+    RunBenchmarkCase("Pooled" + builder, "high", car_count, [&]() {
+        director.BuildHighLevelCar();
+        Car* car = pooled_car_builder.GetCar();
+        std::size_t part_count = car->parts_.size();
+        car_pool.Release(car);
+        return part_count;
+    });
+    director.set_builder(&car_builder);
+
+    BuildPlan low_level_plan = director.RecordLowLevelCar();
+    BuildPlan high_level_plan = director.RecordHighLevelCar();
+    RunBenchmarkCase("Replayed" + builder, "low", car_count, [&]() {
+        low_level_plan.Replay(car_builder);
+        Car* car = car_builder.GetCar();
+        std::size_t part_count = car->parts_.size();
+        delete car;
+        return part_count;
+    });
+    RunBenchmarkCase("Replayed" + builder, "high", car_count, [&]() {
+        high_level_plan.Replay(car_builder);
+        Car* car = car_builder.GetCar();
+        std::size_t part_count = car->parts_.size();
+        delete car;
+        return part_count;
+    });
+
+    // the step lists are reached through volatile pointers, so the compiler cannot fold the build
+    // into a constant car: every call reads the steps and produces the parts at runtime
+    const StaticBuildStep (*volatile low_level_steps)[StaticDirector::kLowLevelPartCount] = &StaticDirector::kLowLevelSteps;
+    const StaticBuildStep (*volatile high_level_steps)[StaticDirector::kHighLevelPartCount] = &StaticDirector::kHighLevelSteps;
+    auto sum_parts = [](const auto& car) {
+        std::size_t part_sum = 0;
+        for (CarPart part : car.parts_) {
+            part_sum += static_cast<std::size_t>(part);
+        }
+        return part_sum;
+    };
+    RunBenchmarkCase("Static" + builder, "low", car_count, [&]() {
+        return sum_parts(StaticDirector::Build<CarParts>(*low_level_steps));
+    });
+    RunBenchmarkCase("Static" + builder, "high", car_count, [&]() {
+        return sum_parts(StaticDirector::Build<CarParts>(*high_level_steps));
+    });
+}
+
+// cars built per second by the builder service, for worker counts up to at least 4 and up to the
+// number of cores, with one producer submitting all requests and with several producers at once.
+// Worker counts above the number of cores (reported as "cores") show the cost of oversubscription,
+// not scaling.
+template <typename DynamicCarBuilder>
+void BenchmarkCarBuilderService(const std::string& builder, std::size_t car_count) {
+    const std::size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t request_size = 1000;
+    std::vector<std::size_t> thread_counts;
+    for (std::size_t thread_count = 1; thread_count < std::max<std::size_t>(4, hardware_threads); thread_count *= 2) {
+        thread_counts.push_back(thread_count);
+    }
+    thread_counts.push_back(std::max<std::size_t>(4, hardware_threads));
+
+    for (std::size_t thread_count : thread_counts) {
+        for (std::size_t producer_count : {1, 4}) {
+            CarBuilderService<DynamicCarBuilder> car_builder_service(thread_count);
+            std::vector<std::thread> producers;
+            std::vector<std::size_t> built_cars(producer_count, 0);
+            std::size_t allocations_before = AllocationCount();
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (std::size_t producer = 0; producer < producer_count; producer++) {
+                producers.emplace_back([&, producer]() {
+                    std::vector<std::future<std::vector<Car*>>> requests;
+                    for (std::size_t submitted = 0; submitted < car_count / producer_count; submitted += request_size) {
+                        requests.push_back(car_builder_service.SubmitHighLevelCars(request_size));
+                    }
+                    for (std::future<std::vector<Car*>>& request : requests) {
+                        for (Car* car : request.get()) {
+                            delete car;
+                            built_cars[producer]++;
+                        }
+                    }
+                });
+            }
+            for (std::thread& producer : producers) {
+                producer.join();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::size_t allocations = AllocationCount() - allocations_before;
+            std::size_t cars = 0;
+            for (std::size_t producer_cars : built_cars) {
+                cars += producer_cars;
+            }
+
+            std::cout << "{\"benchmark\": \"car_builder_service\""
+                      << ", \"builder\": \"" << builder << "\""
+                      << ", \"level\": \"high\""
+                      << ", \"threads\": " << thread_count
+                      << ", \"producers\": " << producer_count
+                      << ", \"cores\": " << hardware_threads
+                      << ", \"cars\": " << cars
+                      << ", \"cars_per_second\": " << cars / elapsed.count()
+                      << ", \"allocations_per_car\": " << static_cast<double>(allocations) / cars
+                      << "}" << std::endl;
+        }
+    }
+}
+
+void RunBenchmarks() {
+    const std::size_t car_count = 2000000;
+    BenchmarkCarBuilder<SmallCarBuilder, SmallCarParts>("SmallCarBuilder", car_count);
+    BenchmarkCarBuilder<LargeCarBuilder, LargeCarParts>("LargeCarBuilder", car_count);
+    BenchmarkCarBuilderService<SmallCarBuilder>("SmallCarBuilder", car_count);
+    BenchmarkCarBuilderService<LargeCarBuilder>("LargeCarBuilder", car_count);
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        RunBenchmarks();
+        return 0;
+    }
+    if (argc > 3 && std::string(argv[1]) == "--orders") {
+        return ProcessOrderFile(argv[2], argv[3]);
+    }
 
-int main() {
     Director* director = new Director();
     ClientCode(*director);
     delete director;
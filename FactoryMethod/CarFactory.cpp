@@ -1,44 +1,202 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <dlfcn.h>
+#endif
 
+// level and horn texts are constants, handed out as views without building strings
 class Car {
   public:
     virtual ~Car() {};
-    virtual std::string ShowLevel() const = 0;
+    virtual std::string_view ShowLevel() const = 0;
 
-    std::string Horn() const {
-      std::string result = "Dii dii ~";
-      return result;
+    std::string_view Horn() const {
+      return "Dii dii ~";
     }
 };
 
 class LowEndCar : public Car {
   public:
-    std::string ShowLevel() const override {
+    std::string_view ShowLevel() const override {
         return "(Low end car)";
     }
 };
 
 class HighEndCar : public Car {
   public:
-    std::string ShowLevel() const override {
+    std::string_view ShowLevel() const override {
         return "(High end car)";
     }
 };
 
 
+/**
+ * Report writer formats a report into a buffer provided by the caller, so no string is allocated.
+ * Text which does not fit into the buffer is cut off; RequiredLength tells how long the buffer
+ * would have to be for the whole report.
+ */
+class ReportWriter {
+  private:
+    char* buffer_;
+    std::size_t capacity_;
+    std::size_t length_ = 0;
+    std::size_t required_length_ = 0;
+
+  public:
+    ReportWriter(char* buffer, std::size_t capacity) : buffer_(buffer), capacity_(capacity) {}
+
+    ReportWriter& Append(std::string_view text) {
+        std::size_t count = std::min(text.size(), capacity_ - length_);
+        if (count > 0) {
+            std::memcpy(buffer_ + length_, text.data(), count);
+        }
+        length_ += count;
+        required_length_ += text.size();
+        return *this;
+    }
+
+    std::string_view View() const {
+        return std::string_view(buffer_, length_);
+    }
+
+    std::size_t RequiredLength() const {
+        return required_length_;
+    }
+};
+
+ReportWriter WriteCarReport(char* buffer, std::size_t buffer_size, const Car& car) {
+    ReportWriter writer(buffer, buffer_size);
+    writer.Append("Factory has produced ").Append(car.ShowLevel()).Append("  ").Append(car.Horn());
+    return writer;
+}
+
+std::string_view FormatCarReport(char* buffer, std::size_t buffer_size, const Car& car) {
+    return WriteCarReport(buffer, buffer_size, car).View();
+}
+
+
+/**
+ * Products handed out by the slab pools below are owned by a CarHandle, which returns the car
+ * to its pool instead of deleting it.
+ */
+class CarRecycler {
+  public:
+    virtual ~CarRecycler() {};
+    virtual void Recycle(Car* car) = 0;
+};
+
+struct CarDeleter {
+    CarRecycler* recycler;
+
+    void operator()(Car* car) const {
+        recycler->Recycle(car);
+    }
+};
+
+using CarHandle = std::unique_ptr<Car, CarDeleter>;
+
+/**
+ * Slab pool for one type of car. Memory is taken from slabs of fixed size and recycled through
+ * a free list, so producing and destroying a car does not call the global allocator once the
+ * first slab exists. The pool is not thread-safe, and must outlive all handles it gave out.
+ * The factories use the pool of the calling thread (ThreadPool), so const factories shared
+ * between threads never touch the same free list without a lock; a pooled car has to be released
+ * on the thread that produced it, before that thread exits.
+ */
+template <typename ConcreteCar>
+class CarSlabPool : public CarRecycler {
+  private:
+    union Slot {
+        Slot* next;
+        alignas(ConcreteCar) unsigned char storage[sizeof(ConcreteCar)];
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> slabs_;
+    Slot* free_slots_ = nullptr;
+    std::size_t slab_size_;
+
+    void AddSlab() {
+        slabs_.emplace_back(new Slot[slab_size_]);
+        Slot* slab = slabs_.back().get();
+        for (std::size_t i = 0; i < slab_size_; i++) {
+            slab[i].next = free_slots_;
+            free_slots_ = &slab[i];
+        }
+    }
+
+  public:
+    explicit CarSlabPool(std::size_t slab_size = 64) : slab_size_(slab_size) {}
+
+    static CarSlabPool& ThreadPool() {
+        thread_local CarSlabPool pool;
+        return pool;
+    }
+
+    CarHandle Produce() {
+        if (free_slots_ == nullptr) {
+            this->AddSlab();
+        }
+        Slot* slot = free_slots_;
+        free_slots_ = slot->next;
+        return CarHandle(new (slot->storage) ConcreteCar(), CarDeleter{this});
+    }
+
+    void Recycle(Car* car) override {
+        ConcreteCar* concrete_car = static_cast<ConcreteCar*>(car);
+        concrete_car->~ConcreteCar();
+        Slot* slot = reinterpret_cast<Slot*>(concrete_car);
+        slot->next = free_slots_;
+        free_slots_ = slot;
+    }
+};
+
+
 
 
 class Factory {
   public:
     virtual ~Factory() {};
     virtual Car* ProduceCar() const = 0;
+    virtual CarHandle ProducePooledCar() const = 0;
+    /**
+     * ProduceCarInto constructs the car in storage owned by the caller (for example on its stack),
+     * which must be at least CarSize() bytes and aligned to alignof(std::max_align_t). The caller
+     * ends the lifetime of the car by calling its destructor explicitly.
+     */
+    virtual Car* ProduceCarInto(void* storage) const = 0;
+    virtual std::size_t CarSize() const = 0;
 
+    // the returned view points into the buffer of the caller
+    std::string_view CheckCar(char* buffer, std::size_t buffer_size) const {
+        CarHandle car = this->ProducePooledCar();
+        return FormatCarReport(buffer, buffer_size, *car);
+    }
+
+    // formats into a stack buffer, and a report that does not fit once more into a string of the
+    // length the writer asked for, so the report is never cut off
     std::string CheckCar() const {
-        Car* car = this->ProduceCar();
-        std::string result = "Factory has produced " + car->ShowLevel() + "  " + car->Horn();
-        delete car;
-        return result;
+        CarHandle car = this->ProducePooledCar();
+        char buffer[128];
+        ReportWriter writer = WriteCarReport(buffer, sizeof(buffer), *car);
+        if (writer.RequiredLength() <= sizeof(buffer)) {
+            return std::string(writer.View());
+        }
+        std::string report(writer.RequiredLength(), '\0');
+        WriteCarReport(&report[0], report.size(), *car);
+        return report;
     }
 };
 
@@ -47,6 +205,18 @@ class LowEndFactory : public Factory {
     Car* ProduceCar() const override {
         return new LowEndCar();
     }
+
+    CarHandle ProducePooledCar() const override {
+        return CarSlabPool<LowEndCar>::ThreadPool().Produce();
+    }
+
+    Car* ProduceCarInto(void* storage) const override {
+        return new (storage) LowEndCar();
+    }
+
+    std::size_t CarSize() const override {
+        return sizeof(LowEndCar);
+    }
 };
 
 class HighEndFactory : public Factory {
@@ -54,18 +224,348 @@ class HighEndFactory : public Factory {
     Car* ProduceCar() const override {
         return new HighEndCar();
     }
+
+    CarHandle ProducePooledCar() const override {
+        return CarSlabPool<HighEndCar>::ThreadPool().Produce();
+    }
+
+    Car* ProduceCarInto(void* storage) const override {
+        return new (storage) HighEndCar();
+    }
+
+    std::size_t CarSize() const override {
+        return sizeof(HighEndCar);
+    }
+};
+
+
+/**
+ * Factory registry: factories register under a name and get a dense id. The name is looked up
+ * once (FindId), and repeated creation goes through the id, which is an index into a vector, so
+ * it never touches the string map.
+ *
+ * Further factories can be loaded from shared objects at startup. A plugin exports the C function
+ * "RegisterCarFactories", which registers its factories. The plugins are opened and registered one
+ * after the other, in the order of their paths (the dynamic loader serializes dlopen anyway). A
+ * plugin that fails to open or to register is unloaded together with the factories it registered,
+ * the others stay loaded, and the failures are reported in one exception at the end.
+ * Building this file with -DCAR_FACTORY_PLUGIN -shared -fPIC gives an example plugin.
+ */
+class FactoryRegistry;
+extern "C" typedef void (*RegisterCarFactoriesFunction)(FactoryRegistry* registry);
+
+class FactoryRegistry {
+  private:
+    std::vector<std::unique_ptr<Factory>> factories_;
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, std::size_t> ids_;
+    std::vector<void*> plugin_handles_;
+
+    // unregisters the factories from first_id on
+    void RemoveFactories(std::size_t first_id) {
+        for (std::size_t id = first_id; id < names_.size(); id++) {
+            ids_.erase(names_[id]);
+        }
+        names_.resize(first_id);
+        factories_.resize(first_id);
+    }
+
+  public:
+    FactoryRegistry() {}
+    FactoryRegistry(const FactoryRegistry& other) = delete;
+    void operator=(const FactoryRegistry&) = delete;
+
+    ~FactoryRegistry() {
+        // the factories of a plugin must be destroyed before its code is unloaded
+        factories_.clear();
+#if defined(__unix__) || defined(__APPLE__)
+        for (void* plugin_handle : plugin_handles_) {
+            dlclose(plugin_handle);
+        }
+#endif
+    }
+
+    std::size_t Register(const std::string& name, std::unique_ptr<Factory> factory) {
+        if (ids_.count(name) != 0) {
+            throw std::invalid_argument("Factory already registered: " + name);
+        }
+        ids_[name] = factories_.size();
+        names_.push_back(name);
+        factories_.push_back(std::move(factory));
+        return factories_.size() - 1;
+    }
+
+    std::size_t FindId(const std::string& name) const {
+        std::unordered_map<std::string, std::size_t>::const_iterator id = ids_.find(name);
+        if (id == ids_.end()) {
+            throw std::out_of_range("Unknown factory: " + name);
+        }
+        return id->second;
+    }
+
+    const Factory& Get(std::size_t id) const {
+        if (id >= factories_.size()) {
+            throw std::out_of_range("Unknown factory id: " + std::to_string(id));
+        }
+        return *factories_[id];
+    }
+
+    const std::string& Name(std::size_t id) const {
+        if (id >= names_.size()) {
+            throw std::out_of_range("Unknown factory id: " + std::to_string(id));
+        }
+        return names_[id];
+    }
+
+    std::size_t size() const {
+        return factories_.size();
+    }
+
+    void LoadPlugins(const std::vector<std::string>& plugin_paths) {
+#if defined(__unix__) || defined(__APPLE__)
+        std::string error_message;
+        for (const std::string& plugin_path : plugin_paths) {
+            void* handle = dlopen(plugin_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+            if (handle == nullptr) {
+                error_message += std::string("\n") + dlerror();
+                continue;
+            }
+            std::size_t first_plugin_id = factories_.size();
+            try {
+                RegisterCarFactoriesFunction register_function =
+                    reinterpret_cast<RegisterCarFactoriesFunction>(dlsym(handle, "RegisterCarFactories"));
+                if (register_function == nullptr) {
+                    throw std::runtime_error(plugin_path + ": no RegisterCarFactories function");
+                }
+                register_function(this);
+                plugin_handles_.push_back(handle);
+            } catch (const std::exception& error) {
+                // the factories of the plugin must go before its code is unloaded
+                this->RemoveFactories(first_plugin_id);
+                dlclose(handle);
+                error_message += std::string("\n") + error.what();
+            }
+        }
+        if (!error_message.empty()) {
+            throw std::runtime_error("Failed to load plugins:" + error_message);
+        }
+#else
+        if (!plugin_paths.empty()) {
+            throw std::runtime_error("Plugins are not supported on this platform");
+        }
+#endif
+    }
+};
+
+
+
+/**
+ * Static dispatch variant for a closed set of factories. The factories derive from the CRTP base
+ * StaticFactory and return their concrete car by value, so ProduceCar and ShowLevel are resolved
+ * at compile time and can be inlined. StaticCarFactory (a std::variant) keeps the choice of the
+ * factory at runtime; std::visit dispatches once per call without a vtable.
+ */
+template <typename ConcreteFactory>
+class StaticFactory {
+  public:
+    std::string_view CheckCar(char* buffer, std::size_t buffer_size) const {
+        auto car = static_cast<const ConcreteFactory*>(this)->ProduceCar();
+        return FormatCarReport(buffer, buffer_size, car);
+    }
 };
 
+class StaticLowEndFactory : public StaticFactory<StaticLowEndFactory> {
+  public:
+    LowEndCar ProduceCar() const {
+        return LowEndCar();
+    }
+};
+
+class StaticHighEndFactory : public StaticFactory<StaticHighEndFactory> {
+  public:
+    HighEndCar ProduceCar() const {
+        return HighEndCar();
+    }
+};
+
+using StaticCarFactory = std::variant<StaticLowEndFactory, StaticHighEndFactory>;
+
+std::string_view CheckCar(const StaticCarFactory& factory, char* buffer, std::size_t buffer_size) {
+    return std::visit([&](const auto& concrete_factory) { return concrete_factory.CheckCar(buffer, buffer_size); }, factory);
+}
+
+
+
+#ifdef CAR_FACTORY_PLUGIN
+
+/**
+ * Example plugin with a factory for mid range cars.
+ */
+class MidRangeCar : public Car {
+  public:
+    std::string_view ShowLevel() const override {
+        return "(Mid range car)";
+    }
+};
+
+class MidRangeFactory : public Factory {
+  public:
+    Car* ProduceCar() const override {
+        return new MidRangeCar();
+    }
+
+    CarHandle ProducePooledCar() const override {
+        return CarSlabPool<MidRangeCar>::ThreadPool().Produce();
+    }
+
+    Car* ProduceCarInto(void* storage) const override {
+        return new (storage) MidRangeCar();
+    }
+
+    std::size_t CarSize() const override {
+        return sizeof(MidRangeCar);
+    }
+};
+
+extern "C" void RegisterCarFactories(FactoryRegistry* registry) {
+    registry->Register("mid-range", std::unique_ptr<Factory>(new MidRangeFactory()));
+}
 
+#else
 
 void ClientCode(const Factory& factory) {
+    char report[128];
     std::cout << "Client: build a car with interface.\n"
-              << factory.CheckCar() 
+              << factory.CheckCar(report, sizeof(report))
               << std::endl;
 }
 
 
-int main() {
+/**
+ * Benchmark, started with "--benchmark": produces and destroys millions of cars with and without
+ * the slab pools, and prints time and heap allocations per car as one JSON line per case.
+ */
+std::atomic<std::size_t> allocation_count(0);
+
+// the replaced operator new and delete below pair malloc with free, which GCC cannot see through
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+// the result of every cycle is stored here, so the cycles are not optimized away
+volatile std::size_t benchmark_sink = 0;
+
+template <typename Cycle>
+void RunBenchmarkCase(const std::string& factory, const std::string& method, std::size_t car_count, Cycle cycle) {
+    std::size_t allocations_before = allocation_count.load();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < car_count; i++) {
+        benchmark_sink = cycle();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::size_t allocations = allocation_count.load() - allocations_before;
+
+    std::cout << "{\"benchmark\": \"factory_method\""
+              << ", \"factory\": \"" << factory << "\""
+              << ", \"method\": \"" << method << "\""
+              << ", \"cars\": " << car_count
+              << ", \"ns_per_car\": " << elapsed.count() * 1e9 / car_count
+              << ", \"allocations_per_car\": " << static_cast<double>(allocations) / car_count
+              << "}" << std::endl;
+}
+
+void BenchmarkFactory(const std::string& name, const Factory& factory, std::size_t car_count) {
+    RunBenchmarkCase(name, "ProduceCar", car_count, [&]() {
+        Car* car = factory.ProduceCar();
+        std::size_t level_length = car->ShowLevel().size();
+        delete car;
+        return level_length;
+    });
+    RunBenchmarkCase(name, "ProducePooledCar", car_count, [&]() {
+        CarHandle car = factory.ProducePooledCar();
+        return car->ShowLevel().size();
+    });
+    RunBenchmarkCase(name, "CheckCar", car_count, [&]() {
+        return factory.CheckCar().size();
+    });
+    RunBenchmarkCase(name, "CheckCarIntoBuffer", car_count, [&]() {
+        char report[128];
+        return factory.CheckCar(report, sizeof(report)).size();
+    });
+}
+
+// tight production loop (produce, show level, destroy) with vtable dispatch against static dispatch.
+// All three cases build the car on the stack, so the difference is the dispatch alone.
+template <typename ConcreteStaticFactory>
+void BenchmarkDispatch(const std::string& name, const Factory& factory, const StaticCarFactory& variant_factory, std::size_t car_count) {
+    alignas(std::max_align_t) unsigned char storage[64];
+    if (factory.CarSize() > sizeof(storage)) {
+        throw std::length_error("Car of " + name + " does not fit into the benchmark storage");
+    }
+    RunBenchmarkCase(name, "VirtualDispatch", car_count, [&]() {
+        Car* car = factory.ProduceCarInto(storage);
+        std::size_t level_length = car->ShowLevel().size();
+        car->~Car();
+        return level_length;
+    });
+    RunBenchmarkCase(name, "VariantDispatch", car_count, [&]() {
+        return std::visit([](const auto& concrete_factory) { return concrete_factory.ProduceCar().ShowLevel().size(); }, variant_factory);
+    });
+    ConcreteStaticFactory static_factory;
+    RunBenchmarkCase(name, "CrtpDispatch", car_count, [&]() {
+        return static_factory.ProduceCar().ShowLevel().size();
+    });
+}
+
+void RunBenchmarks() {
+    const std::size_t car_count = 5000000;
+    LowEndFactory low_end_factory;
+    HighEndFactory high_end_factory;
+    BenchmarkFactory("LowEndFactory", low_end_factory, car_count);
+    BenchmarkFactory("HighEndFactory", high_end_factory, car_count);
+    BenchmarkDispatch<StaticLowEndFactory>("LowEndFactory", low_end_factory, StaticLowEndFactory(), car_count);
+    BenchmarkDispatch<StaticHighEndFactory>("HighEndFactory", high_end_factory, StaticHighEndFactory(), car_count);
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        RunBenchmarks();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--plugins") {
+        FactoryRegistry registry;
+        registry.Register("low-end", std::unique_ptr<Factory>(new LowEndFactory()));
+        registry.Register("high-end", std::unique_ptr<Factory>(new HighEndFactory()));
+        try {
+            registry.LoadPlugins(std::vector<std::string>(argv + 2, argv + argc));
+        } catch (const std::exception& error) {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
+        for (std::size_t id = 0; id < registry.size(); id++) {
+            std::cout << "App: Launch with " << registry.Name(id) << " factory.\n";
+            ClientCode(registry.Get(id));
+        }
+        return 0;
+    }
+
     std::cout << "App: Launch with low end car.\n";
     Factory* factory_low_end = new LowEndFactory();
     ClientCode(*factory_low_end);
@@ -75,7 +575,29 @@ int main() {
     Factory* factory_high_end = new HighEndFactory();
     ClientCode(*factory_high_end);
 
+    std::cout << std::endl;
+
+    std::cout << "App: Launch with factory from registry.\n";
+    FactoryRegistry registry;
+    registry.Register("low-end", std::unique_ptr<Factory>(new LowEndFactory()));
+    registry.Register("high-end", std::unique_ptr<Factory>(new HighEndFactory()));
+    const std::size_t high_end_id = registry.FindId("high-end");   // looked up once
+    for (int i = 0; i < 2; i++) {
+        ClientCode(registry.Get(high_end_id));
+    }
+
+    std::cout << std::endl;
+
+    std::cout << "App: Launch with static dispatch factories.\n";
+    std::vector<StaticCarFactory> static_factories = {StaticLowEndFactory(), StaticHighEndFactory()};
+    for (const StaticCarFactory& static_factory : static_factories) {
+        char report[128];
+        std::cout << CheckCar(static_factory, report, sizeof(report)) << std::endl;
+    }
+
     delete factory_low_end;
     delete factory_high_end;
     return 0;
-}
\ No newline at end of file
+}
+
+#endif
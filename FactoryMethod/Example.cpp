@@ -1,5 +1,7 @@
 #include <iostream>
 #include <string>
+#include <variant>
+#include <vector>
 
 /**
  * Factory Method Design Pattern
@@ -90,6 +92,42 @@ class ConcreteCreator2 : public Creator {
   }
 };
 
+/**
+ * When the set of creators is closed, the factory method can also be bound at
+ * compile time. The Static Creator is a CRTP base: it calls the factory method
+ * of the derived class directly, and the product is returned by value, so the
+ * whole path can be inlined by the compiler.
+ */
+template <typename ConcreteCreator>
+class StaticCreator {
+ public:
+  std::string SomeOperation() const {
+    auto product = static_cast<const ConcreteCreator *>(this)->FactoryMethod();
+    std::string result = "StaticCreator: The same creator's code has just worked with " + product.Operation();
+    return result;
+  }
+};
+
+class StaticConcreteCreator1 : public StaticCreator<StaticConcreteCreator1> {
+ public:
+  ConcreteProduct1 FactoryMethod() const {
+    return ConcreteProduct1();
+  }
+};
+
+class StaticConcreteCreator2 : public StaticCreator<StaticConcreteCreator2> {
+ public:
+  ConcreteProduct2 FactoryMethod() const {
+    return ConcreteProduct2();
+  }
+};
+
+/**
+ * A std::variant of the static creators still lets the application pick the
+ * creator at runtime; std::visit replaces the virtual call.
+ */
+using AnyStaticCreator = std::variant<StaticConcreteCreator1, StaticConcreteCreator2>;
+
 /**
  * The client code works with an instance of a concrete creator, albeit through
  * its base interface. As long as the client keeps working with the creator via
@@ -116,6 +154,13 @@ int main() {
   Creator* creator2 = new ConcreteCreator2();
   ClientCode(*creator2);
 
+  std::cout << std::endl;
+  std::cout << "App: Launched with the static creators.\n";
+  std::vector<AnyStaticCreator> static_creators = {StaticConcreteCreator1(), StaticConcreteCreator2()};
+  for (const AnyStaticCreator &static_creator : static_creators) {
+    std::cout << std::visit([](const auto &concrete_creator) { return concrete_creator.SomeOperation(); }, static_creator) << std::endl;
+  }
+
   delete creator;
   delete creator2;
   return 0;
@@ -0,0 +1,140 @@
+/**
+ * Clone Benchmark harness shared by the Prototype examples
+ *
+ * Started with "--benchmark", the examples measure what cloning costs compared with constructing
+ * the objects directly. Every measurement is printed as one JSON line: latency per object,
+ * throughput, heap allocations per object and the growth of the resident set during the case.
+ * Allocations are counted in allocation_count, which the program increments from its own global
+ * operator new.
+ */
+
+#ifndef PROTOTYPE_CLONE_BENCHMARK_H
+#define PROTOTYPE_CLONE_BENCHMARK_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+// heap allocations of the program so far, counted by the replacement of the global operator new
+// in the translation unit that owns main, since a replacement has to be defined once per program
+inline std::atomic<std::size_t> allocation_count(0);
+
+// resident set of the process right now, 0 where it cannot be read
+inline long CurrentResidentSetKilobytes() {
+#if defined(__linux__)
+    std::FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr) {
+        return 0;
+    }
+    long total_pages = 0, resident_pages = 0;
+    int fields = std::fscanf(statm, "%ld %ld", &total_pages, &resident_pages);
+    std::fclose(statm);
+    return fields == 2 ? resident_pages * (sysconf(_SC_PAGESIZE) / 1024) : 0;
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return static_cast<long>(info.resident_size / 1024);
+#else
+    return 0;
+#endif
+}
+
+struct BenchmarkCase {
+    std::string class_name;
+    std::string method;
+    std::size_t payload_bytes;
+    std::size_t object_count;
+    std::size_t thread_count;
+};
+
+/**
+ * Runs operation(begin, end) over the objects [0, object_count), split into one slice per thread.
+ * Every slice is timed in chunks, which gives the latency distribution per object. The objects are
+ * still alive when the case ends, so the growth of the resident set is the memory they hold; heap
+ * memory freed by earlier cases is given back to the system first where the allocator allows it.
+ */
+template <typename Operation>
+void RunBenchmarkCase(const BenchmarkCase &benchmark_case, Operation operation) {
+    const std::size_t chunk_size = 256;
+    const std::size_t slice_size = (benchmark_case.object_count + benchmark_case.thread_count - 1) / benchmark_case.thread_count;
+    std::vector<std::vector<double>> latencies(benchmark_case.thread_count);
+    for (std::vector<double> &thread_latencies : latencies) {
+        thread_latencies.reserve(slice_size / chunk_size + 1);
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(benchmark_case.thread_count);
+
+    auto run_slice = [&](std::size_t thread_index) {
+        std::size_t slice_begin = thread_index * slice_size;
+        std::size_t slice_end = std::min(slice_begin + slice_size, benchmark_case.object_count);
+        for (std::size_t begin = slice_begin; begin < slice_end; begin += chunk_size) {
+            std::size_t end = std::min(begin + chunk_size, slice_end);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            operation(begin, end);
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            latencies[thread_index].push_back(elapsed.count() / (end - begin));
+        }
+    };
+
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+    long resident_before = CurrentResidentSetKilobytes();
+    std::size_t allocations_before = allocation_count.load();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (benchmark_case.thread_count == 1) {
+        run_slice(0);
+    } else {
+        for (std::size_t thread_index = 0; thread_index < benchmark_case.thread_count; thread_index++) {
+            workers.emplace_back(run_slice, thread_index);
+        }
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::size_t allocations = allocation_count.load() - allocations_before;
+    long resident_growth = CurrentResidentSetKilobytes() - resident_before;
+
+    std::vector<double> all_latencies;
+    for (const std::vector<double> &thread_latencies : latencies) {
+        all_latencies.insert(all_latencies.end(), thread_latencies.begin(), thread_latencies.end());
+    }
+    std::sort(all_latencies.begin(), all_latencies.end());
+    double mean_ns = elapsed.count() * 1e9 * benchmark_case.thread_count / benchmark_case.object_count;
+
+    std::cout << "{\"benchmark\": \"prototype_clone\""
+              << ", \"class\": \"" << benchmark_case.class_name << "\""
+              << ", \"method\": \"" << benchmark_case.method << "\""
+              << ", \"payload_bytes\": " << benchmark_case.payload_bytes
+              << ", \"threads\": " << benchmark_case.thread_count
+              << ", \"objects\": " << benchmark_case.object_count
+              << ", \"mean_ns\": " << mean_ns
+              << ", \"p50_ns\": " << all_latencies[all_latencies.size() / 2]
+              << ", \"p99_ns\": " << all_latencies[all_latencies.size() * 99 / 100]
+              << ", \"objects_per_second\": " << benchmark_case.object_count / elapsed.count()
+              << ", \"allocations_per_object\": " << static_cast<double>(allocations) / benchmark_case.object_count
+              << ", \"rss_growth_kb\": " << resident_growth
+              << "}" << std::endl;
+}
+
+#endif  // PROTOTYPE_CLONE_BENCHMARK_H
@@ -7,9 +7,87 @@
  *
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "CloneBenchmark.h"
+
+// count the heap allocations for the clone benchmark (allocation_count in CloneBenchmark.h); the
+// replaced operator new and delete pair malloc with free, which GCC cannot see through
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+/**
+ * Copy-on-write block holds heavy, mostly immutable model data (mesh, texture, ...). Copies of the
+ * block share the same data through a reference count. The data is only duplicated when a shared
+ * block is written to, so a clone costs the same memory no matter how large the data is.
+ * A moved-from block reads as empty data and gets new data on its next write.
+ */
+template <typename T>
+class CopyOnWriteBlock
+{
+private:
+    std::shared_ptr<T> data_;
+
+public:
+    CopyOnWriteBlock() : data_(std::make_shared<T>()) {}
+    CopyOnWriteBlock(T data) : data_(std::make_shared<T>(std::move(data))) {}
+
+    const T &Read() const {
+        static const T empty_data;
+        return data_ ? *data_ : empty_data;
+    }
+
+    T &Write() {
+        if (!data_) {
+            data_ = std::make_shared<T>();
+        } else if (data_.use_count() > 1) {
+            data_ = std::make_shared<T>(*data_);
+        }
+        return *data_;
+    }
+
+    // gives this block its own copy of the data, with a reference count of its own
+    void Unshare() {
+        if (data_ && data_.use_count() > 1) {
+            data_ = std::make_shared<T>(*data_);
+        }
+    }
+
+    bool IsShared() const {
+        return data_.use_count() > 1;
+    }
+};
 
 /**
  * Reference Object (prototype interface) is the interface for all the reference 
@@ -20,17 +98,71 @@ class ModelObject
 protected:
     std::string object_name_;
     int object_size_;
+    CopyOnWriteBlock<std::vector<float>> mesh_;
+    CopyOnWriteBlock<std::vector<unsigned char>> texture_;
 
 public:
     ModelObject() {}
     ModelObject(std::string object_name) : object_name_(object_name) {}
+    ModelObject(std::string object_name, std::vector<float> mesh, std::vector<unsigned char> texture)
+        : object_name_(object_name), mesh_(std::move(mesh)), texture_(std::move(texture)) {}
 
     virtual ~ModelObject() {}
     virtual ModelObject *CloneObject() const = 0;
+
+    /**
+     * Clone into caller-provided storage (pool slot, arena, ...) instead of the heap. The storage
+     * must hold CloneSize() bytes aligned to CloneAlignment(). The caller owns the storage and
+     * destroys the clone by calling its destructor explicitly.
+     */
+    virtual ModelObject *CloneObjectInto(void *storage) const = 0;
+    virtual std::size_t CloneSize() const = 0;
+    virtual std::size_t CloneAlignment() const = 0;
+
+    /**
+     * Clone count objects into contiguous storage (count * CloneSize() bytes) and write their
+     * addresses to clones. One virtual call covers the whole batch.
+     */
+    virtual void CloneObjectsInto(void *storage, std::size_t count, ModelObject **clones) const = 0;
+
     virtual void SetSize(int object_size) {
         this->object_size_ = object_size;
         std::cout << "Object " << object_name_ << "'s size is set to " << object_size << std::endl;
     }
+
+    // Mesh and texture are shared with the reference object until they are modified
+    void ScaleMesh(float factor) {
+        for (float &vertex : mesh_.Write()) {
+            vertex *= factor;
+        }
+    }
+
+    void SetTexture(std::vector<unsigned char> texture) {
+        texture_ = CopyOnWriteBlock<std::vector<unsigned char>>(std::move(texture));
+    }
+
+    const std::vector<float> &mesh() const {
+        return mesh_.Read();
+    }
+
+    const std::vector<unsigned char> &texture() const {
+        return texture_.Read();
+    }
+
+    // copies mesh and texture, so that clones of this object no longer count references on the
+    // blocks of the object it was cloned from
+    void UnshareBlocks() {
+        mesh_.Unshare();
+        texture_.Unshare();
+    }
+
+    bool SharesMesh() const {
+        return mesh_.IsShared();
+    }
+
+    bool SharesTexture() const {
+        return texture_.IsShared();
+    }
 };
 
 /**
@@ -43,10 +175,31 @@ private:
 
 public:
     ModelTableObject(std::string object_name, int object_size) : ModelObject(object_name), table_size_(object_size) {}
+    ModelTableObject(std::string object_name, int object_size, std::vector<float> mesh, std::vector<unsigned char> texture)
+        : ModelObject(object_name, std::move(mesh), std::move(texture)), table_size_(object_size) {}
 
     ModelObject *CloneObject() const override {
         return new ModelTableObject(*this);
     }
+
+    ModelObject *CloneObjectInto(void *storage) const override {
+        return new (storage) ModelTableObject(*this);
+    }
+
+    std::size_t CloneSize() const override {
+        return sizeof(ModelTableObject);
+    }
+
+    std::size_t CloneAlignment() const override {
+        return alignof(ModelTableObject);
+    }
+
+    void CloneObjectsInto(void *storage, std::size_t count, ModelObject **clones) const override {
+        ModelTableObject *objects = static_cast<ModelTableObject *>(storage);
+        for (std::size_t i = 0; i < count; i++) {
+            clones[i] = new (objects + i) ModelTableObject(*this);
+        }
+    }
 };
 
 /**
@@ -59,10 +212,245 @@ private:
 
 public:
     ModelChairObject(std::string object_name, int object_size) : ModelObject(object_name), chair_size_(object_size) {}
+    ModelChairObject(std::string object_name, int object_size, std::vector<float> mesh, std::vector<unsigned char> texture)
+        : ModelObject(object_name, std::move(mesh), std::move(texture)), chair_size_(object_size) {}
 
     ModelObject *CloneObject() const override {
         return new ModelChairObject(*this);
     }
+
+    ModelObject *CloneObjectInto(void *storage) const override {
+        return new (storage) ModelChairObject(*this);
+    }
+
+    std::size_t CloneSize() const override {
+        return sizeof(ModelChairObject);
+    }
+
+    std::size_t CloneAlignment() const override {
+        return alignof(ModelChairObject);
+    }
+
+    void CloneObjectsInto(void *storage, std::size_t count, ModelObject **clones) const override {
+        ModelChairObject *objects = static_cast<ModelChairObject *>(storage);
+        for (std::size_t i = 0; i < count; i++) {
+            clones[i] = new (objects + i) ModelChairObject(*this);
+        }
+    }
+};
+
+/**
+ * Model Object Arena hands out storage for clones from one pre-allocated block, so that mass
+ * instantiation of objects does not call the global allocator per object. All clones living in
+ * the arena are destroyed together when the arena is cleared or destroyed.
+*/
+class ModelObjectArena {
+  private:
+    // Starting and joining a thread costs about 20-25 us, cloning a table or chair about 100 ns
+    // (measured on x86-64 Linux). A slice of 4096 clones is about 400 us of work, so the thread
+    // overhead stays below 10%; smaller batches are cloned on the calling thread.
+    static constexpr std::size_t kMinClonesPerThread = 4096;
+
+    unsigned char *buffer_;
+    std::size_t capacity_;
+    std::size_t offset_;
+    std::vector<ModelObject *> objects_;
+
+  public:
+    ModelObjectArena(std::size_t capacity, std::size_t max_objects)
+        : buffer_(static_cast<unsigned char *>(::operator new(capacity))), capacity_(capacity), offset_(0) {
+        objects_.reserve(max_objects);
+    }
+
+    ModelObjectArena(const ModelObjectArena &other) = delete;
+    void operator=(const ModelObjectArena &) = delete;
+
+    ~ModelObjectArena() {
+        this->Clear();
+        ::operator delete(buffer_);
+    }
+
+    // alignment must be a power of two not larger than alignof(std::max_align_t)
+    void *Allocate(std::size_t size, std::size_t alignment) {
+        std::size_t aligned_offset = (offset_ + alignment - 1) & ~(alignment - 1);
+        if (aligned_offset + size > capacity_) {
+            throw std::bad_alloc();
+        }
+        offset_ = aligned_offset + size;
+        return buffer_ + aligned_offset;
+    }
+
+    ModelObject *Clone(const ModelObject &prototype) {
+        void *storage = this->Allocate(prototype.CloneSize(), prototype.CloneAlignment());
+        ModelObject *clone = prototype.CloneObjectInto(storage);
+        objects_.push_back(clone);
+        return clone;
+    }
+
+    /**
+     * Clone count objects of one prototype into a contiguous block of the arena. Large batches
+     * are split into slices which are initialized by multiple threads. Returns the index of the
+     * first clone in the arena. If a clone throws, the clones of the batch are destroyed, the
+     * arena is left as it was before the call, and the exception is passed on.
+     */
+    std::size_t CloneBatch(const ModelObject &prototype, std::size_t count) {
+        std::size_t first = objects_.size();
+        std::size_t offset_before = offset_;
+        std::size_t stride = prototype.CloneSize();
+        unsigned char *storage = static_cast<unsigned char *>(this->Allocate(stride * count, prototype.CloneAlignment()));
+        // unused slots stay null, so a failed batch knows which clones exist
+        objects_.resize(first + count, nullptr);
+        ModelObject **clones = objects_.data() + first;
+
+        std::size_t thread_count = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), count / kMinClonesPerThread);
+        try {
+            if (thread_count <= 1) {
+                prototype.CloneObjectsInto(storage, count, clones);
+                return first;
+            }
+
+            // Every clone counts a reference on the mesh and texture blocks of its prototype. To
+            // keep the threads off a shared reference count, each further thread clones from its
+            // own copy of the prototype with unshared blocks, at the cost of one copy of the data
+            // per thread; the clones of one slice share the data of that copy.
+            std::vector<std::unique_ptr<ModelObject>> slice_prototypes;
+            for (std::size_t worker = 1; worker < thread_count; worker++) {
+                slice_prototypes.emplace_back(prototype.CloneObject());
+                slice_prototypes.back()->UnshareBlocks();
+            }
+
+            std::vector<std::thread> workers;
+            std::vector<std::exception_ptr> errors(thread_count);
+            std::size_t slice = (count + thread_count - 1) / thread_count;
+            for (std::size_t worker = 0; worker * slice < count; worker++) {
+                const ModelObject &slice_prototype = worker == 0 ? prototype : *slice_prototypes[worker - 1];
+                std::size_t begin = worker * slice;
+                std::size_t slice_count = std::min(slice, count - begin);
+                workers.emplace_back([&slice_prototype, &errors, storage, stride, clones, worker, begin, slice_count] {
+                    try {
+                        slice_prototype.CloneObjectsInto(storage + begin * stride, slice_count, clones + begin);
+                    } catch (...) {
+                        errors[worker] = std::current_exception();
+                    }
+                });
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            for (const std::exception_ptr &error : errors) {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        } catch (...) {
+            for (std::size_t i = first; i < objects_.size(); i++) {
+                if (objects_[i] != nullptr) {
+                    objects_[i]->~ModelObject();
+                }
+            }
+            objects_.resize(first);
+            offset_ = offset_before;
+            throw;
+        }
+        return first;
+    }
+
+    void Clear() {
+        for (ModelObject *object : objects_) {
+            object->~ModelObject();
+        }
+        objects_.clear();
+        offset_ = 0;
+    }
+
+    std::size_t size() const {
+        return objects_.size();
+    }
+
+    ModelObject *object(std::size_t index) const {
+        return objects_[index];
+    }
+};
+
+/**
+ * Dense ids of the reference objects in the library. They are used as array index for the
+ * reference objects, so that the lookup on the hot path is a single array access.
+*/
+enum ModelType {
+    MODEL_TABLE = 0,
+    MODEL_CHAIR,
+    MODEL_TYPE_COUNT
+};
+
+/**
+ * Model Type Registry maps the type names to the dense ids. The set of names is frozen at startup,
+ * after which a seed for the string hash is searched such that every name lands in its own slot
+ * (perfect hashing). A lookup hashes the name once and compares it with a single candidate; unknown
+ * names are reported with an exception instead of being inserted silently.
+*/
+class ModelTypeRegistry {
+  private:
+    std::vector<std::string> names_;
+    std::vector<int> slots_;
+    std::uint64_t seed_;
+
+    static std::uint64_t Hash(const std::string &name, std::uint64_t seed) {
+        std::uint64_t hash = 14695981039346656037ull ^ seed;
+        for (unsigned char c : name) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        return hash ^ (hash >> 29);
+    }
+
+    std::size_t Slot(const std::string &name, std::uint64_t seed) const {
+        return Hash(name, seed) & (slots_.size() - 1);
+    }
+
+    bool TryBuildSlots(std::size_t slot_count) {
+        slots_.assign(slot_count, -1);
+        for (std::size_t id = 0; id < names_.size(); id++) {
+            int &slot = slots_[Slot(names_[id], seed_)];
+            if (slot != -1) {
+                return false;
+            }
+            slot = static_cast<int>(id);
+        }
+        return true;
+    }
+
+  public:
+    ModelTypeRegistry(std::vector<std::string> names) : names_(std::move(names)), seed_(0) {
+        // equal names always hash to the same slot, the seed search would never end
+        std::vector<std::string> sorted_names(names_);
+        std::sort(sorted_names.begin(), sorted_names.end());
+        std::vector<std::string>::const_iterator duplicate = std::adjacent_find(sorted_names.begin(), sorted_names.end());
+        if (duplicate != sorted_names.end()) {
+            throw std::invalid_argument("Duplicate model type: " + *duplicate);
+        }
+
+        std::size_t slot_count = 1;
+        while (slot_count < 2 * names_.size()) {
+            slot_count *= 2;
+        }
+        while (!this->TryBuildSlots(slot_count)) {
+            seed_++;
+            if (seed_ % 64 == 0) {
+                slot_count *= 2;   // table too crowded, retry with more room
+            }
+        }
+    }
+
+    std::size_t Find(const std::string &name) const {
+        int id = slots_[Slot(name, seed_)];
+        if (id == -1 || names_[id] != name) {
+            throw std::out_of_range("Unknown model type: " + name);
+        }
+        return static_cast<std::size_t>(id);
+    }
+
+    const std::string &Name(std::size_t id) const {
+        return names_.at(id);
+    }
 };
 
 /**
@@ -70,21 +458,80 @@ public:
 */
 class ModelLibrary {
   private:
-    std::unordered_map<std::string, ModelObject *, std::hash<std::string>> reference_objects_;
+    ModelTypeRegistry model_types_;
+    ModelObject *reference_objects_[MODEL_TYPE_COUNT];
+
+    const ModelObject &ReferenceObject(ModelType model_type) const {
+        if (model_type < 0 || model_type >= MODEL_TYPE_COUNT) {
+            throw std::out_of_range("Unknown model type id: " + std::to_string(model_type));
+        }
+        return *reference_objects_[model_type];
+    }
 
   public:
-    ModelLibrary() {
-        reference_objects_["Table"] = new ModelTableObject("Table object", 60);
-        reference_objects_["Chair"] = new ModelChairObject("Chair object", 40);
+    // names are registered in the order of the ModelType ids
+    ModelLibrary() : model_types_({"Table", "Chair"}) {
+        reference_objects_[MODEL_TABLE] = new ModelTableObject("Table object", 60, std::vector<float>(3 * 20000, 1.0f), std::vector<unsigned char>(256 * 256 * 4, 128));
+        reference_objects_[MODEL_CHAIR] = new ModelChairObject("Chair object", 40, std::vector<float>(3 * 8000, 1.0f), std::vector<unsigned char>(128 * 128 * 4, 64));
     }
 
+    ModelLibrary(const ModelLibrary &other) = delete;
+    void operator=(const ModelLibrary &) = delete;
+
     ~ModelLibrary() {
-        delete reference_objects_["Table"];
-        delete reference_objects_["Chair"];
+        for (ModelObject *reference_object : reference_objects_) {
+            delete reference_object;
+        }
+    }
+
+    // Resolve a type name once, e.g. when the user picks an object in the library
+    ModelType FindModelType(const std::string &model_type) const {
+        return static_cast<ModelType>(model_types_.Find(model_type));
+    }
+
+    ModelObject *CreateModelObject(ModelType model_type) const {
+        return this->ReferenceObject(model_type).CloneObject();
+    }
+
+    ModelObject *CreateModelObject(const std::string &model_type) const {
+        return this->CreateModelObject(this->FindModelType(model_type));
+    }
+
+    ModelObject *CreateModelObject(ModelType model_type, ModelObjectArena &arena) const {
+        return arena.Clone(this->ReferenceObject(model_type));
+    }
+
+    ModelObject *CreateModelObject(const std::string &model_type, ModelObjectArena &arena) const {
+        return this->CreateModelObject(this->FindModelType(model_type), arena);
+    }
+
+    /**
+     * Batch creation resolves the reference object once per batch instead of once per object.
+     * Returns the arena index of the first created object.
+     */
+    std::size_t CreateModelObjects(ModelType model_type, std::size_t count, ModelObjectArena &arena) const {
+        return arena.CloneBatch(this->ReferenceObject(model_type), count);
+    }
+
+    std::size_t CreateModelObjects(const std::string &model_type, std::size_t count, ModelObjectArena &arena) const {
+        return this->CreateModelObjects(this->FindModelType(model_type), count, arena);
     }
 
-    ModelObject *CreateModelObject(std::string model_type) {
-        return reference_objects_[model_type]->CloneObject();
+    std::size_t CreateModelObjects(const std::vector<std::pair<ModelType, std::size_t>> &batch, ModelObjectArena &arena) const {
+        std::size_t first = arena.size();
+        for (const std::pair<ModelType, std::size_t> &request : batch) {
+            arena.CloneBatch(this->ReferenceObject(request.first), request.second);
+        }
+        return first;
+    }
+
+    std::size_t CreateModelObjects(const std::vector<std::pair<std::string, std::size_t>> &batch, ModelObjectArena &arena) const {
+        std::vector<std::pair<ModelType, std::size_t>> resolved_batch;
+        resolved_batch.reserve(batch.size());
+        for (const std::pair<std::string, std::size_t> &request : batch) {
+            resolved_batch.emplace_back(this->FindModelType(request.first), request.second);
+        }
+        return this->CreateModelObjects(resolved_batch, arena);
     }
 };
 
@@ -97,6 +544,9 @@ void Client(ModelLibrary &model_library) {
 
     ModelObject *model_object = model_library.CreateModelObject("Table");
     model_object->SetSize(10);
+    std::cout << "Table shares mesh: " << model_object->SharesMesh() << ", shares texture: " << model_object->SharesTexture() << "\n";
+    model_object->ScaleMesh(2.0f);
+    std::cout << "After scaling, table shares mesh: " << model_object->SharesMesh() << ", shares texture: " << model_object->SharesTexture() << "\n";
     delete model_object;
 
     std::cout << "\n";
@@ -116,9 +566,113 @@ void Client(ModelLibrary &model_library) {
     model_object->SetSize(80);
 
     delete model_object;
+
+    std::cout << "\n";
+
+    std::cout << "Start to create an unknown object\n";
+
+    try {
+        model_library.CreateModelObject("Lamp");
+    } catch (const std::out_of_range &error) {
+        std::cout << error.what() << "\n";
+    }
+
+    std::cout << "\n";
+
+    std::cout << "Start to create 100000 tables and chairs in an arena\n";
+
+    const std::size_t object_count = 100000;
+    const ModelType table_type = model_library.FindModelType("Table");
+    const ModelType chair_type = model_library.FindModelType("Chair");
+    ModelObjectArena arena(object_count * sizeof(ModelTableObject) + object_count * sizeof(ModelChairObject), 2 * object_count);
+    for (std::size_t i = 0; i < object_count; i++) {
+        model_library.CreateModelObject(table_type, arena);
+        model_library.CreateModelObject(chair_type, arena);
+    }
+    std::cout << "Arena holds " << arena.size() << " objects\n";
+
+    std::cout << "\n";
+
+    std::cout << "Start to create a crowd of 1000000 tables and chairs in one batch\n";
+
+    const std::size_t crowd_count = 500000;
+    ModelObjectArena crowd_arena(crowd_count * sizeof(ModelTableObject) + crowd_count * sizeof(ModelChairObject) + 64, 2 * crowd_count);
+    model_library.CreateModelObjects({{MODEL_TABLE, crowd_count}, {MODEL_CHAIR, crowd_count}}, crowd_arena);
+    std::cout << "Crowd arena holds " << crowd_arena.size() << " objects\n";
+}
+
+/**
+ * Clone Benchmark cases of the reference objects, run with "--benchmark" (harness in CloneBenchmark.h)
+ */
+template <typename ConcreteModelObject>
+void BenchmarkModelObject(const std::string &class_name, std::size_t payload_floats, std::size_t thread_count) {
+    const std::size_t clone_count = 100000;
+    const std::size_t memory_budget = 64 * 1024 * 1024;
+    const std::size_t payload_bytes = payload_floats * sizeof(float);
+    const std::size_t stride = sizeof(ConcreteModelObject);
+    const ConcreteModelObject prototype("Model object", 60, std::vector<float>(payload_floats, 1.0f), std::vector<unsigned char>());
+    std::vector<ModelObject *> objects(clone_count);
+
+    RunBenchmarkCase({class_name, "CloneObject", payload_bytes, clone_count, thread_count}, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            objects[i] = prototype.CloneObject();
+        }
+    });
+    for (ModelObject *object : objects) {
+        delete object;
+    }
+
+    unsigned char *storage = static_cast<unsigned char *>(::operator new(clone_count * stride));
+    RunBenchmarkCase({class_name, "CloneObjectInto", payload_bytes, clone_count, thread_count}, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            objects[i] = prototype.CloneObjectInto(storage + i * stride);
+        }
+    });
+    for (ModelObject *object : objects) {
+        object->~ModelObject();
+    }
+
+    RunBenchmarkCase({class_name, "CloneObjectsInto", payload_bytes, clone_count, thread_count}, [&](std::size_t begin, std::size_t end) {
+        prototype.CloneObjectsInto(storage + begin * stride, end - begin, objects.data() + begin);
+    });
+    for (ModelObject *object : objects) {
+        object->~ModelObject();
+    }
+    ::operator delete(storage);
+
+    // direct construction copies the payload, so the number of objects is limited by a memory budget
+    const std::size_t construct_count = std::max<std::size_t>(16, std::min(clone_count, memory_budget / std::max<std::size_t>(payload_bytes, 1)));
+    RunBenchmarkCase({class_name, "Construct", payload_bytes, construct_count, thread_count}, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            objects[i] = new ConcreteModelObject("Model object", 60, prototype.mesh(), prototype.texture());
+        }
+    });
+    for (std::size_t i = 0; i < construct_count; i++) {
+        delete objects[i];
+    }
+}
+
+void RunBenchmarks() {
+    std::vector<std::size_t> thread_counts = {1};
+    const std::size_t hardware_threads = std::thread::hardware_concurrency();
+    for (std::size_t thread_count = 2; thread_count <= hardware_threads; thread_count *= 2) {
+        thread_counts.push_back(thread_count);
+    }
+
+    for (std::size_t payload_floats : {0, 1024, 65536, 1048576}) {
+        for (std::size_t thread_count : thread_counts) {
+            BenchmarkModelObject<ModelTableObject>("ModelTableObject", payload_floats, thread_count);
+            BenchmarkModelObject<ModelChairObject>("ModelChairObject", payload_floats, thread_count);
+        }
+    }
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        RunBenchmarks();
+        return 0;
+    }
+
     ModelLibrary *model_library = new ModelLibrary();
     Client(*model_library);
     delete model_library;
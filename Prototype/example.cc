@@ -1,9 +1,41 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
 #include <iostream>
+#include <new>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
+
+#include "CloneBenchmark.h"
 
 using std::string;
 
+// count the heap allocations for the clone benchmark (allocation_count in CloneBenchmark.h); the
+// replaced operator new and delete pair malloc with free, which GCC cannot see through
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void *pointer = std::malloc(size == 0 ? 1 : size)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
 // Prototype Design Pattern
 //
 // Intent: Lets you copy existing objects without making your code dependent on
@@ -31,6 +63,15 @@ class Prototype {
   }
   virtual ~Prototype() {}
   virtual Prototype *Clone() const = 0;
+  /**
+   * CloneInto constructs the replica in storage owned by the caller (a pool slot
+   * or an arena), which must be at least CloneSize() bytes and aligned to
+   * CloneAlignment(). No heap allocation happens; the caller ends the lifetime
+   * of the replica by calling its destructor explicitly.
+   */
+  virtual Prototype *CloneInto(void *storage) const = 0;
+  virtual std::size_t CloneSize() const = 0;
+  virtual std::size_t CloneAlignment() const = 0;
   virtual void Method(float prototype_field) {
     this->prototype_field_ = prototype_field;
     std::cout << "Call Method from " << prototype_name_ << " with field : " << prototype_field << std::endl;
@@ -63,6 +104,15 @@ class ConcretePrototype1 : public Prototype {
   Prototype *Clone() const override {
     return new ConcretePrototype1(*this);
   }
+  Prototype *CloneInto(void *storage) const override {
+    return new (storage) ConcretePrototype1(*this);
+  }
+  std::size_t CloneSize() const override {
+    return sizeof(ConcretePrototype1);
+  }
+  std::size_t CloneAlignment() const override {
+    return alignof(ConcretePrototype1);
+  }
 };
 
 class ConcretePrototype2 : public Prototype {
@@ -76,6 +126,15 @@ class ConcretePrototype2 : public Prototype {
   Prototype *Clone() const override {
     return new ConcretePrototype2(*this);
   }
+  Prototype *CloneInto(void *storage) const override {
+    return new (storage) ConcretePrototype2(*this);
+  }
+  std::size_t CloneSize() const override {
+    return sizeof(ConcretePrototype2);
+  }
+  std::size_t CloneAlignment() const override {
+    return alignof(ConcretePrototype2);
+  }
 };
 
 /**
@@ -111,6 +170,14 @@ class PrototypeFactory {
   Prototype *CreatePrototype(Type type) {
     return prototypes_[type]->Clone();
   }
+
+  Prototype *CreatePrototypeInto(Type type, void *storage) {
+    return prototypes_[type]->CloneInto(storage);
+  }
+
+  const Prototype &GetPrototype(Type type) {
+    return *prototypes_[type];
+  }
 };
 
 void Client(PrototypeFactory &prototype_factory) {
@@ -128,9 +195,83 @@ void Client(PrototypeFactory &prototype_factory) {
   prototype->Method(10);
 
   delete prototype;
+
+  std::cout << "\n";
+
+  std::cout << "Let's create a Prototype 1 in caller-provided storage\n";
+
+  alignas(std::max_align_t) unsigned char storage[128];
+  if (prototype_factory.GetPrototype(Type::PROTOTYPE_1).CloneSize() <= sizeof(storage)) {
+    prototype = prototype_factory.CreatePrototypeInto(Type::PROTOTYPE_1, storage);
+    prototype->Method(30);
+    prototype->~Prototype();
+  }
 }
 
-int main() {
+/**
+ * Clone benchmark cases of the concrete prototypes, run with "--benchmark"
+ * (harness in CloneBenchmark.h). The payload is the length of the prototype
+ * name, which has to be copied on every clone.
+ */
+template <typename ConcretePrototype>
+void BenchmarkPrototype(const string &class_name, std::size_t name_length, std::size_t thread_count) {
+  const std::size_t object_count = 100000;
+  const std::size_t stride = sizeof(ConcretePrototype);
+  const string prototype_name(name_length, 'p');
+  const ConcretePrototype prototype(prototype_name, 50.f);
+  std::vector<Prototype *> objects(object_count);
+
+  RunBenchmarkCase({class_name, "Clone", name_length, object_count, thread_count}, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+      objects[i] = prototype.Clone();
+    }
+  });
+  for (Prototype *object : objects) {
+    delete object;
+  }
+
+  unsigned char *storage = static_cast<unsigned char *>(::operator new(object_count * stride));
+  RunBenchmarkCase({class_name, "CloneInto", name_length, object_count, thread_count}, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+      objects[i] = prototype.CloneInto(storage + i * stride);
+    }
+  });
+  for (Prototype *object : objects) {
+    object->~Prototype();
+  }
+  ::operator delete(storage);
+
+  RunBenchmarkCase({class_name, "Construct", name_length, object_count, thread_count}, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+      objects[i] = new ConcretePrototype(prototype_name, 50.f);
+    }
+  });
+  for (Prototype *object : objects) {
+    delete object;
+  }
+}
+
+void RunBenchmarks() {
+  std::vector<std::size_t> thread_counts = {1};
+  const std::size_t hardware_threads = std::thread::hardware_concurrency();
+  for (std::size_t thread_count = 2; thread_count <= hardware_threads; thread_count *= 2) {
+    thread_counts.push_back(thread_count);
+  }
+
+  for (std::size_t name_length : {8, 64, 1024}) {
+    for (std::size_t thread_count : thread_counts) {
+      BenchmarkPrototype<ConcretePrototype1>("ConcretePrototype1", name_length, thread_count);
+      BenchmarkPrototype<ConcretePrototype2>("ConcretePrototype2", name_length, thread_count);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && string(argv[1]) == "--benchmark") {
+    RunBenchmarks();
+    return 0;
+  }
+
   PrototypeFactory *prototype_factory = new PrototypeFactory();
   Client(*prototype_factory);
   delete prototype_factory;